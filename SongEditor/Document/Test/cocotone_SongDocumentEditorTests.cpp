@@ -0,0 +1,121 @@
+namespace cctn
+{
+namespace song
+{
+
+//==============================================================================
+class SongDocumentEditorTests final : public juce::UnitTest
+{
+public:
+    SongDocumentEditorTests() : juce::UnitTest("SongDocumentEditor", "cocotone") {}
+
+    void runTest() override
+    {
+        beginTest("quantize strength 0 keeps notes in place");
+        {
+            const auto document = makeOffGridDocument();
+            const auto timings_before = getTimings(*document);
+
+            SongDocumentEditor editor;
+            editor.attachDocument(document);
+            editor.getEditorContext().currentGridSize = NoteLength::Sixteenth;
+            editor.updateEditorContext();
+
+            QueryForQuantizePianoRollNotes query;
+            query.strength = 0.0;
+            query.quantizeEnd = true;
+            editor.quantizeNotes(query);
+
+            const auto timings_after = getTimings(*document);
+            expectEquals((int)timings_after.size(), (int)timings_before.size());
+            for (size_t i = 0; i < timings_before.size(); ++i)
+            {
+                expectEquals(timings_after[i].noteOnTick, timings_before[i].noteOnTick);
+                expectEquals(timings_after[i].noteOffTick, timings_before[i].noteOffTick);
+            }
+        }
+
+        beginTest("quantize strength 1 moves notes onto the grid and keeps their length");
+        {
+            const auto document = makeOffGridDocument();
+            const auto timings_before = getTimings(*document);
+
+            SongDocumentEditor editor;
+            editor.attachDocument(document);
+            editor.getEditorContext().currentGridSize = NoteLength::Sixteenth;
+            editor.updateEditorContext();
+
+            QueryForQuantizePianoRollNotes query;
+            query.strength = 1.0;
+            editor.quantizeNotes(query);
+
+            const auto timings_after = getTimings(*document);
+            for (size_t i = 0; i < timings_before.size(); ++i)
+            {
+                const auto nearest_grid_tick = (timings_before[i].noteOnTick + kTicksPerSixteenth / 2) / kTicksPerSixteenth * kTicksPerSixteenth;
+                expectEquals(timings_after[i].noteOnTick, nearest_grid_tick);
+                expectEquals(timings_after[i].noteOffTick - timings_after[i].noteOnTick,
+                             timings_before[i].noteOffTick - timings_before[i].noteOnTick);
+            }
+        }
+
+        beginTest("quantize with swing delays every second step");
+        {
+            const auto document = makeOffGridDocument();
+            const auto timings_before = getTimings(*document);
+
+            SongDocumentEditor editor;
+            editor.attachDocument(document);
+            editor.getEditorContext().currentGridSize = NoteLength::Sixteenth;
+            editor.updateEditorContext();
+            editor.setGrooveTemplate(GrooveTemplate::makeSwing(2.0 / 3.0));
+
+            QueryForQuantizePianoRollNotes query;
+            editor.quantizeNotes(query);
+
+            const auto timings_after = getTimings(*document);
+            for (size_t i = 0; i < timings_before.size(); ++i)
+            {
+                const auto step_index = (timings_before[i].noteOnTick + kTicksPerSixteenth / 2) / kTicksPerSixteenth;
+                const auto swing_offset = (step_index % 2 == 1) ? kTicksPerSixteenth / 3 : 0;
+                expectEquals(timings_after[i].noteOnTick, step_index * kTicksPerSixteenth + swing_offset);
+            }
+        }
+    }
+
+private:
+    static constexpr int64_t kTicksPerSixteenth = SongDocument::kDefaultTicksPerQuarterNote / 4;
+
+    // Short notes a little off the sixteenth grid, far enough apart to stay apart when quantized.
+    static std::shared_ptr<SongDocument> makeOffGridDocument()
+    {
+        auto document = std::make_shared<SongDocument>();
+
+        const int offsets[] = { 7, -11, 23, -29, 0, 41 };
+        for (int i = 0; i < 16; ++i)
+        {
+            const auto tick = (int64_t)(i * 3 + 1) * kTicksPerSixteenth + offsets[i % 6];
+            document->addNote(SongDocument::DataFactory::makeNote(*document,
+                SongDocument::Calculator::tickToBar(*document, tick),
+                SongDocument::NoteDuration(50 + i), 60 + i, 100, "a"));
+        }
+
+        return document;
+    }
+
+    // In start order, which quantize keeps for notes this far apart.
+    static std::vector<SongDocument::NoteTiming> getTimings(const SongDocument& document)
+    {
+        std::vector<SongDocument::NoteTiming> timings;
+        for (const auto slot : document.getNotes().getSlotsInStartOrder())
+        {
+            timings.push_back(document.getNotes()[slot].getTiming());
+        }
+        return timings;
+    }
+};
+
+static SongDocumentEditorTests songDocumentEditorTests;
+
+}
+}
@@ -0,0 +1,250 @@
+namespace cctn
+{
+namespace song
+{
+
+//==============================================================================
+class SongDocumentTests final : public juce::UnitTest
+{
+public:
+    SongDocumentTests() : juce::UnitTest("SongDocument", "cocotone") {}
+
+    void runTest() override
+    {
+        using Calculator = SongDocument::Calculator;
+        using TempoEvent = SongDocument::TempoEvent;
+
+        beginTest("barToTick and tickToBar round trip over time signature changes");
+        {
+            const auto document = createTestSongDocument();
+
+            for (int64_t tick = 0; tick < document.getTotalLengthInTicks(); tick += 7)
+            {
+                const auto musical_time = Calculator::tickToBar(document, tick);
+                expectEquals(Calculator::barToTick(document, musical_time), tick);
+            }
+
+            // Bar 5 is the first bar of 3/4.
+            expectEquals(Calculator::barToTick(document, { 5, 1, 0 }), (int64_t)1920 * 4);
+            expectEquals(Calculator::barToTick(document, { 6, 1, 0 }), (int64_t)1920 * 4 + 1440);
+        }
+
+        beginTest("tickToSamples and samplesToTick round trip");
+        {
+            const auto document = createTestSongDocument();
+
+            for (const auto sample_rate : { 44100.0, 48000.0, 96000.0 })
+            {
+                auto previous_samples = (int64_t)-1;
+                for (int64_t tick = 0; tick < document.getTotalLengthInTicks(); tick += 3)
+                {
+                    const auto samples = Calculator::tickToSamples(document, tick, sample_rate);
+                    expect(samples > previous_samples);
+                    expectEquals(Calculator::samplesToTick(document, samples, sample_rate), tick);
+                    previous_samples = samples;
+                }
+            }
+        }
+
+        beginTest("tickToSamples is continuous at a tempo change of non-integer BPM");
+        {
+            SongDocument document;
+            document.addTempoEvent(0, TempoEvent::TempoEventType::kTempo, 4, 4, 97.3333);
+            document.addTempoEvent(1000000, TempoEvent::TempoEventType::kTempo, 4, 4, 71.11119);
+
+            const auto sample_rate = 48000.0;
+            const auto before = Calculator::tickToSamples(document, 999999, sample_rate);
+            const auto at = Calculator::tickToSamples(document, 1000000, sample_rate);
+            const auto after = Calculator::tickToSamples(document, 1000001, sample_rate);
+
+            // About 61.6 samples per tick before and 84.4 after the change.
+            expect(61 <= at - before && at - before <= 62);
+            expect(84 <= after - at && after - at <= 85);
+        }
+
+        beginTest("tempo ramps follow the closed form integral");
+        {
+            const int64_t ramp_length = 1920 * 8;
+            const auto ticks_per_quarter_note = (double)SongDocument::kDefaultTicksPerQuarterNote;
+
+            SongDocument linear_document;
+            linear_document.addTempoEvent(0, TempoEvent::TempoEventType::kTempo, 4, 4, 120.0, TempoEvent::TempoCurve::kLinear);
+            linear_document.addTempoEvent(ramp_length, TempoEvent::TempoEventType::kTempo, 4, 4, 240.0);
+
+            // Linear tempo: 60 / PPQ * length / (end - start) * ln(end / start).
+            expectWithinAbsoluteError(Calculator::tickToAbsoluteTime(linear_document, ramp_length),
+                60.0 / ticks_per_quarter_note * (double)ramp_length / 120.0 * std::log(2.0), 1.0e-9);
+
+            SongDocument exponential_document;
+            exponential_document.addTempoEvent(0, TempoEvent::TempoEventType::kTempo, 4, 4, 120.0, TempoEvent::TempoCurve::kExponential);
+            exponential_document.addTempoEvent(ramp_length, TempoEvent::TempoEventType::kTempo, 4, 4, 240.0);
+
+            // Exponential tempo: 60 / (PPQ * start) * length * (1 - start / end) / ln(end / start).
+            expectWithinAbsoluteError(Calculator::tickToAbsoluteTime(exponential_document, ramp_length),
+                60.0 / (ticks_per_quarter_note * 120.0) * (double)ramp_length * 0.5 / std::log(2.0), 1.0e-9);
+
+            for (const auto* document : { &linear_document, &exponential_document })
+            {
+                auto previous_time = -1.0;
+                for (int64_t tick = 0; tick <= ramp_length + 1920; tick += 5)
+                {
+                    const auto time = Calculator::tickToAbsoluteTime(*document, tick);
+                    expect(time > previous_time);
+                    previous_time = time;
+
+                    const auto samples = Calculator::tickToSamples(*document, tick, 44100.0);
+                    expectEquals(Calculator::samplesToTick(*document, samples, 44100.0), tick);
+                }
+            }
+        }
+
+        beginTest("note store add, remove and reinsert");
+        {
+            SongDocument document;
+            const SongDocument::NoteDuration quarter(480);
+
+            const auto first = SongDocument::DataFactory::makeNote(document, { 1, 1, 0 }, quarter, 60, 100, "a");
+            const auto second = SongDocument::DataFactory::makeNote(document, { 1, 2, 0 }, quarter, 62, 100, "b");
+            const auto third = SongDocument::DataFactory::makeNote(document, { 1, 3, 0 }, quarter, 64, 100, "c");
+            document.addNote(first);
+            document.addNote(second);
+            document.addNote(third);
+            expectEquals(document.getNotes().size(), 3);
+
+            document.removeNote(first.id);
+            expectEquals(document.getNotes().size(), 2);
+            expect(!document.findNoteById(first.id).has_value());
+            expect(!document.getLyricTable().findId("a").has_value());
+
+            // Last note is moved into the freed slot, lookups by id still find every note.
+            for (const auto& note : { second, third })
+            {
+                const auto view = document.findNoteById(note.id);
+                expect(view.has_value());
+                expectEquals(view->getNoteNumber(), note.noteNumber);
+                expectEquals(view->getLyric(), note.lyric);
+            }
+
+            document.addNote(first);
+            expectEquals(document.getNotes().size(), 3);
+
+            const auto view = document.findNoteById(first.id);
+            expect(view.has_value());
+            expectEquals(view->getTiming().noteOnTick, (int64_t)0);
+            expectEquals(view->getLyric(), juce::String("a"));
+            expectEquals((int)document.findNotesAtTick(0).size(), 1);
+
+            const auto slots = document.getNotes().getSlotsInStartOrder();
+            expectEquals(document.getNotes()[slots.front()].getId(), first.id);
+            expectEquals(document.getNotes()[slots.back()].getId(), third.id);
+        }
+
+        beginTest("interval index matches a linear scan");
+        {
+            NoteIntervalIndex index;
+            std::vector<std::tuple<int, int, juce::Range<int64_t>>> entries;
+
+            auto random = getRandom();
+            for (int note_id = 0; note_id < 500; ++note_id)
+            {
+                const auto start = (int64_t)random.nextInt(20000);
+                const auto range = juce::Range<int64_t>(start, start + 1 + random.nextInt(random.nextBool() ? 100 : 5000));
+                const auto note_number = random.nextInt(4) + 60;
+                index.add(note_id, note_number, range);
+                entries.emplace_back(note_id, note_number, range);
+            }
+
+            for (size_t i = 0; i < entries.size(); i += 2)
+            {
+                index.remove(std::get<0>(entries[i]), std::get<1>(entries[i]), std::get<2>(entries[i]));
+            }
+            expectEquals((int)index.size(), 250);
+
+            for (int query = 0; query < 200; ++query)
+            {
+                const auto start = (int64_t)random.nextInt(21000);
+                const auto range = juce::Range<int64_t>(start, start + 1 + random.nextInt(1000));
+                const auto tick = (int64_t)random.nextInt(21000);
+
+                std::vector<int> expected_overlapping;
+                std::vector<int> expected_containing;
+                for (size_t i = 1; i < entries.size(); i += 2)
+                {
+                    const auto& [note_id, note_number, note_range] = entries[i];
+                    if (note_range.intersects(range))
+                    {
+                        expected_overlapping.push_back(note_id);
+                    }
+                    if (note_range.contains(tick))
+                    {
+                        expected_containing.push_back(note_id);
+                    }
+                }
+
+                auto overlapping = index.findOverlapping(range);
+                auto containing = index.findContaining(tick);
+                std::sort(overlapping.begin(), overlapping.end());
+                std::sort(containing.begin(), containing.end());
+
+                expect(overlapping == expected_overlapping);
+                expect(containing == expected_containing);
+            }
+        }
+
+        beginTest("lyric table shares kana and reuses released ids");
+        {
+            LyricTable table;
+
+            const auto kana_id = table.acquire(juce::CharPointer_UTF8("\xe3\x83\xa9"));
+            expect(kana_id < LyricTable::getNumSeededLyrics());
+            table.release(kana_id);
+            expect(table.findId(juce::CharPointer_UTF8("\xe3\x83\xa9")).has_value());
+
+            const auto lyric_id = table.acquire("la");
+            expect(lyric_id >= LyricTable::getNumSeededLyrics());
+            expectEquals(table.acquire("la"), lyric_id);
+            expectEquals(table.getText(lyric_id), juce::String("la"));
+
+            table.release(lyric_id);
+            expect(table.findId("la").has_value());
+            table.release(lyric_id);
+            expect(!table.findId("la").has_value());
+
+            expectEquals(table.acquire("lu"), lyric_id);
+            expectEquals(table.getText(lyric_id), juce::String("lu"));
+        }
+
+        beginTest("note id allocator");
+        {
+            SongDocument::NoteIdAllocator allocator;
+
+            const auto first_id = allocator.allocate();
+            expectEquals(allocator.allocate(), first_id + 1);
+
+            const auto block = allocator.allocateBlock(10);
+            expectEquals(block.getStart(), first_id + 2);
+            expectEquals(block.getLength(), 10);
+
+            allocator.reserveUpTo(100);
+            expectEquals(allocator.allocate(), 101);
+            allocator.reserveUpTo(50);
+            expectEquals(allocator.allocate(), 102);
+        }
+
+        beginTest("toJson and fromJson round trip");
+        {
+            auto document = createTestSongDocument();
+            document.removeNote(document.getNotes()[document.getNotes().size() - 1].getId());
+
+            const auto loaded = SongDocument::fromJson(document.toJson());
+            expect(loaded != nullptr);
+            expectEquals(loaded->dumpToString(), document.dumpToString());
+            expectEquals(loaded->getNoteIdAllocator().getNextId(), document.getNoteIdAllocator().getNextId());
+        }
+    }
+};
+
+static SongDocumentTests songDocumentTests;
+
+}
+}
@@ -0,0 +1,62 @@
+namespace cctn
+{
+namespace song
+{
+
+//==============================================================================
+BeatTimePointsCache::BeatTimePointsCache()
+{
+}
+
+BeatTimePointsCache::~BeatTimePointsCache()
+{
+}
+
+//==============================================================================
+BeatTimePointsCache::SharedBeatTimePoints BeatTimePointsCache::getBeatTimePoints(const cctn::song::SongDocument& document, cctn::song::NoteLength gridSize)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    auto& cached_grid = cachedGrids[(size_t)gridSize];
+
+    if (cached_grid.beatTimePoints != nullptr && cached_grid.revision == document.getRevision())
+    {
+        return cached_grid.beatTimePoints;
+    }
+
+    // Revisions are unique across documents, so a grid of another document is never patched.
+    const auto first_changed_tick = (cached_grid.beatTimePoints != nullptr)
+        ? document.findFirstChangedTickSince(cached_grid.revision)
+        : std::nullopt;
+
+    if (!first_changed_tick.has_value())
+    {
+        cached_grid.beatTimePoints = std::make_shared<const cctn::song::SongDocument::BeatTimePoints>(
+            cctn::song::SongDocument::BeatTimePointsFactory::makeBeatTimePoints(document, gridSize));
+    }
+    else if (first_changed_tick.value() != std::numeric_limits<int64_t>::max())
+    {
+        // Views may still hold the old grid, so patch into a new one.
+        cached_grid.beatTimePoints = std::make_shared<const cctn::song::SongDocument::BeatTimePoints>(
+            cctn::song::SongDocument::BeatTimePointsFactory::patchBeatTimePoints(document, gridSize, *cached_grid.beatTimePoints, first_changed_tick.value()));
+    }
+
+    cached_grid.revision = document.getRevision();
+
+    return cached_grid.beatTimePoints;
+}
+
+void BeatTimePointsCache::clear()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    // Views may still hold the old grids, they are released with the last reference.
+    for (auto& cached_grid : cachedGrids)
+    {
+        cached_grid.beatTimePoints.reset();
+        cached_grid.revision = 0;
+    }
+}
+
+}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+namespace cctn
+{
+namespace song
+{
+
+//==============================================================================
+// Whole song grids per NoteLength, tagged with the document revision.
+// Built on first request and shared by every view until the document changes.
+// After an edit only the part from the first changed tick is regenerated.
+// Grids are built per NoteLength from the bar lines of the tempo map segments, not derived from a coarser grid,
+// because seconds of every point come from the segment's tempo curve anyway.
+class BeatTimePointsCache final
+{
+public:
+    //==============================================================================
+    using SharedBeatTimePoints = std::shared_ptr<const cctn::song::SongDocument::BeatTimePoints>;
+
+    //==============================================================================
+    BeatTimePointsCache();
+    ~BeatTimePointsCache();
+
+    //==============================================================================
+    // Message thread only.
+    SharedBeatTimePoints getBeatTimePoints(const cctn::song::SongDocument& document, cctn::song::NoteLength gridSize);
+    void clear();
+
+private:
+    //==============================================================================
+    struct CachedGrid
+    {
+        SharedBeatTimePoints beatTimePoints;
+        uint64_t revision{ 0 };
+    };
+    std::array<CachedGrid, kNumNoteLengths> cachedGrids;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BeatTimePointsCache)
+};
+
+}
+}
@@ -0,0 +1,286 @@
+namespace cctn
+{
+namespace song
+{
+
+//==============================================================================
+NoteIntervalIndex::NoteIntervalIndex()
+{
+}
+
+NoteIntervalIndex::~NoteIntervalIndex()
+{
+}
+
+//==============================================================================
+void NoteIntervalIndex::add(int noteId, int noteNumber, juce::Range<int64_t> rangeInTicks)
+{
+    jassert(0 <= noteNumber && noteNumber < kNumNoteNumbers);
+
+    const Entry entry{ rangeInTicks.getStart(), rangeInTicks.getEnd(), noteId };
+    allNotes.add(entry);
+    notesByNoteNumber[(size_t)noteNumber].add(entry);
+}
+
+void NoteIntervalIndex::remove(int noteId, int noteNumber, juce::Range<int64_t> rangeInTicks)
+{
+    jassert(0 <= noteNumber && noteNumber < kNumNoteNumbers);
+
+    const Entry entry{ rangeInTicks.getStart(), rangeInTicks.getEnd(), noteId };
+    allNotes.remove(entry);
+    notesByNoteNumber[(size_t)noteNumber].remove(entry);
+}
+
+void NoteIntervalIndex::clear()
+{
+    allNotes = Lane();
+    for (auto& lane : notesByNoteNumber)
+    {
+        lane = Lane();
+    }
+}
+
+//==============================================================================
+std::vector<int> NoteIntervalIndex::findOverlapping(juce::Range<int64_t> rangeInTicks) const
+{
+    std::vector<int> note_ids;
+    allNotes.collectOverlapping(rangeInTicks, note_ids);
+
+    return note_ids;
+}
+
+std::vector<int> NoteIntervalIndex::findOverlapping(juce::Range<int64_t> rangeInTicks, juce::Range<int> noteNumbers) const
+{
+    std::vector<int> note_ids;
+
+    const auto lane_range = noteNumbers.getIntersectionWith({ 0, kNumNoteNumbers });
+    for (auto note_number = lane_range.getStart(); note_number < lane_range.getEnd(); ++note_number)
+    {
+        notesByNoteNumber[(size_t)note_number].collectOverlapping(rangeInTicks, note_ids);
+    }
+
+    return note_ids;
+}
+
+std::vector<int> NoteIntervalIndex::findContaining(int64_t tick) const
+{
+    return findOverlapping({ tick, tick + 1 });
+}
+
+std::vector<int> NoteIntervalIndex::findContaining(int64_t tick, int noteNumber) const
+{
+    return findOverlapping({ tick, tick + 1 }, { noteNumber, noteNumber + 1 });
+}
+
+//==============================================================================
+namespace
+{
+    // Treap priority from the note id, so shape doesn't depend on insertion order. Murmur3 finalizer.
+    uint32_t makeNodePriority(int noteId)
+    {
+        auto hash = (uint32_t)noteId;
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6bu;
+        hash ^= hash >> 13;
+        hash *= 0xc2b2ae35u;
+        hash ^= hash >> 16;
+
+        return hash;
+    }
+}
+
+//==============================================================================
+void NoteIntervalIndex::Lane::add(const Entry& entry)
+{
+    int new_node_index;
+    if (!freeNodeIndices.empty())
+    {
+        new_node_index = freeNodeIndices.back();
+        freeNodeIndices.pop_back();
+    }
+    else
+    {
+        new_node_index = (int)nodes.size();
+        nodes.emplace_back();
+    }
+
+    nodes[(size_t)new_node_index] = { entry, entry.endTick, makeNodePriority(entry.noteId), -1, -1 };
+
+    rootIndex = insertNode(rootIndex, new_node_index);
+    ++numEntries;
+}
+
+void NoteIntervalIndex::Lane::remove(const Entry& entry)
+{
+    int erased_index = -1;
+    rootIndex = eraseNode(rootIndex, entry, erased_index);
+
+    if (erased_index < 0)
+    {
+        jassertfalse;
+        return;
+    }
+
+    freeNodeIndices.push_back(erased_index);
+    --numEntries;
+}
+
+void NoteIntervalIndex::Lane::collectOverlapping(juce::Range<int64_t> rangeInTicks, std::vector<int>& destNoteIds) const
+{
+    collectOverlappingFrom(rootIndex, rangeInTicks, destNoteIds);
+}
+
+//==============================================================================
+void NoteIntervalIndex::Lane::updateMaxEndTick(int nodeIndex)
+{
+    auto& node = nodes[(size_t)nodeIndex];
+
+    node.maxEndTick = node.entry.endTick;
+    if (node.left >= 0)
+    {
+        node.maxEndTick = std::max(node.maxEndTick, nodes[(size_t)node.left].maxEndTick);
+    }
+    if (node.right >= 0)
+    {
+        node.maxEndTick = std::max(node.maxEndTick, nodes[(size_t)node.right].maxEndTick);
+    }
+}
+
+// Entries before the key go left, the rest right.
+void NoteIntervalIndex::Lane::split(int nodeIndex, const Entry& key, int& destLeftIndex, int& destRightIndex)
+{
+    if (nodeIndex < 0)
+    {
+        destLeftIndex = -1;
+        destRightIndex = -1;
+        return;
+    }
+
+    auto& node = nodes[(size_t)nodeIndex];
+    if (node.entry < key)
+    {
+        split(node.right, key, node.right, destRightIndex);
+        destLeftIndex = nodeIndex;
+    }
+    else
+    {
+        split(node.left, key, destLeftIndex, node.left);
+        destRightIndex = nodeIndex;
+    }
+
+    updateMaxEndTick(nodeIndex);
+}
+
+// Every entry of the left tree is before every entry of the right tree.
+int NoteIntervalIndex::Lane::merge(int leftIndex, int rightIndex)
+{
+    if (leftIndex < 0)
+    {
+        return rightIndex;
+    }
+    if (rightIndex < 0)
+    {
+        return leftIndex;
+    }
+
+    if (nodes[(size_t)leftIndex].priority > nodes[(size_t)rightIndex].priority)
+    {
+        nodes[(size_t)leftIndex].right = merge(nodes[(size_t)leftIndex].right, rightIndex);
+        updateMaxEndTick(leftIndex);
+        return leftIndex;
+    }
+
+    nodes[(size_t)rightIndex].left = merge(leftIndex, nodes[(size_t)rightIndex].left);
+    updateMaxEndTick(rightIndex);
+    return rightIndex;
+}
+
+int NoteIntervalIndex::Lane::insertNode(int nodeIndex, int newNodeIndex)
+{
+    if (nodeIndex < 0)
+    {
+        return newNodeIndex;
+    }
+
+    auto& new_node = nodes[(size_t)newNodeIndex];
+    if (new_node.priority > nodes[(size_t)nodeIndex].priority)
+    {
+        split(nodeIndex, new_node.entry, new_node.left, new_node.right);
+        updateMaxEndTick(newNodeIndex);
+        return newNodeIndex;
+    }
+
+    auto& node = nodes[(size_t)nodeIndex];
+    if (new_node.entry < node.entry)
+    {
+        node.left = insertNode(node.left, newNodeIndex);
+    }
+    else
+    {
+        node.right = insertNode(node.right, newNodeIndex);
+    }
+
+    updateMaxEndTick(nodeIndex);
+    return nodeIndex;
+}
+
+int NoteIntervalIndex::Lane::eraseNode(int nodeIndex, const Entry& key, int& destErasedIndex)
+{
+    if (nodeIndex < 0)
+    {
+        return -1;
+    }
+
+    auto& node = nodes[(size_t)nodeIndex];
+    if (key < node.entry)
+    {
+        node.left = eraseNode(node.left, key, destErasedIndex);
+    }
+    else if (node.entry < key)
+    {
+        node.right = eraseNode(node.right, key, destErasedIndex);
+    }
+    else
+    {
+        destErasedIndex = nodeIndex;
+        return merge(node.left, node.right);
+    }
+
+    updateMaxEndTick(nodeIndex);
+    return nodeIndex;
+}
+
+// In order walk, so ids come out in start tick order.
+void NoteIntervalIndex::Lane::collectOverlappingFrom(int nodeIndex, juce::Range<int64_t> rangeInTicks, std::vector<int>& destNoteIds) const
+{
+    if (nodeIndex < 0)
+    {
+        return;
+    }
+
+    const auto& node = nodes[(size_t)nodeIndex];
+
+    // Nothing below ends after the range start.
+    if (node.maxEndTick <= rangeInTicks.getStart())
+    {
+        return;
+    }
+
+    collectOverlappingFrom(node.left, rangeInTicks, destNoteIds);
+
+    // This note and everything right of it start at or after the range end.
+    if (node.entry.startTick >= rangeInTicks.getEnd())
+    {
+        return;
+    }
+
+    if (node.entry.endTick > rangeInTicks.getStart())
+    {
+        destNoteIds.push_back(node.entry.noteId);
+    }
+
+    collectOverlappingFrom(node.right, rangeInTicks, destNoteIds);
+}
+
+}
+}
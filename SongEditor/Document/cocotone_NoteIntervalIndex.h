@@ -0,0 +1,95 @@
+#pragma once
+
+namespace cctn
+{
+namespace song
+{
+
+//==============================================================================
+// Note tick ranges ordered by start tick, for range and point queries without scanning every note.
+// Kept once for all notes and once per note number, so piano roll hit tests check pitch as well.
+// Each lane is a treap keyed on start tick, augmented with the max end tick of each subtree.
+// A query skips every subtree which ends before the range or starts after it, so long notes
+// don't widen the search. Add and remove are O(log n) expected.
+class NoteIntervalIndex final
+{
+public:
+    //==============================================================================
+    static constexpr int kNumNoteNumbers = 128;
+
+    //==============================================================================
+    NoteIntervalIndex();
+    ~NoteIntervalIndex();
+
+    //==============================================================================
+    // Range is half-open. Note number must be in [0, kNumNoteNumbers), SongDocument rejects others.
+    // Remove with the same values the note was added with.
+    void add(int noteId, int noteNumber, juce::Range<int64_t> rangeInTicks);
+    void remove(int noteId, int noteNumber, juce::Range<int64_t> rangeInTicks);
+    void clear();
+
+    size_t size() const { return allNotes.numEntries; }
+
+    //==============================================================================
+    // Ids of notes which overlap the half-open range, in start tick order.
+    std::vector<int> findOverlapping(juce::Range<int64_t> rangeInTicks) const;
+
+    // Same, only notes in the half-open note number range. Ordered by note number, then start tick.
+    std::vector<int> findOverlapping(juce::Range<int64_t> rangeInTicks, juce::Range<int> noteNumbers) const;
+
+    // Ids of notes which contain the tick, in start tick order.
+    std::vector<int> findContaining(int64_t tick) const;
+    std::vector<int> findContaining(int64_t tick, int noteNumber) const;
+
+private:
+    //==============================================================================
+    struct Entry
+    {
+        int64_t startTick;
+        int64_t endTick;
+        int noteId;
+
+        bool operator<(const Entry& other) const
+        {
+            return std::tie(startTick, noteId) < std::tie(other.startTick, other.noteId);
+        }
+    };
+
+    // Nodes live in a vector and link by index, so a lane copies with the document.
+    struct Node
+    {
+        Entry entry;
+        int64_t maxEndTick;
+        uint32_t priority;
+        int left;
+        int right;
+    };
+
+    struct Lane
+    {
+        std::vector<Node> nodes;
+        std::vector<int> freeNodeIndices;
+        int rootIndex{ -1 };
+        size_t numEntries{ 0 };
+
+        void add(const Entry& entry);
+        void remove(const Entry& entry);
+        void collectOverlapping(juce::Range<int64_t> rangeInTicks, std::vector<int>& destNoteIds) const;
+
+    private:
+        void updateMaxEndTick(int nodeIndex);
+        void split(int nodeIndex, const Entry& key, int& destLeftIndex, int& destRightIndex);
+        int merge(int leftIndex, int rightIndex);
+        int insertNode(int nodeIndex, int newNodeIndex);
+        int eraseNode(int nodeIndex, const Entry& key, int& destErasedIndex);
+        void collectOverlappingFrom(int nodeIndex, juce::Range<int64_t> rangeInTicks, std::vector<int>& destNoteIds) const;
+    };
+
+    Lane allNotes;
+    std::array<Lane, kNumNoteNumbers> notesByNoteNumber;
+
+    JUCE_LEAK_DETECTOR(NoteIntervalIndex)
+};
+
+}
+}
@@ -6,9 +6,16 @@ namespace song
 
 //==============================================================================
 SongDocument::SongDocument()
-    : ticksPerQuarterNote(480)
+    : ticksPerQuarterNote(kDefaultTicksPerQuarterNote)
     , minimumTotalLengthInTicks(ticksPerQuarterNote * 4 * 128)
+    , totalLengthInTicks(minimumTotalLengthInTicks)
 {
+    tempoMap.rebuild(tempoTrack, ticksPerQuarterNote);
+    updateTotalLengthInTicks();
+
+    // Nothing to patch from before construction.
+    updateRevision(0);
+    revisionChanges.clear();
 }
 
 SongDocument::~SongDocument()
@@ -22,48 +29,470 @@ void SongDocument::setMetadata(const juce::String& title, const juce::String& ar
     metadata.artist = artist;
     metadata.created = juce::Time::getCurrentTime();
     metadata.lastModified = metadata.created;
+
+    updateRevision(std::numeric_limits<int64_t>::max());
+}
+
+void SongDocument::addTempoEvent(int64_t tick, TempoEvent::TempoEventType type, int numerator, int denominator, double tempo, TempoEvent::TempoCurve curve)
+{
+    tempoTrack.addEvent(TempoEvent(tick, type, numerator, denominator, tempo, curve));
+
+    updateTempoDerivedData(tick);
+}
+
+void SongDocument::loadTempoEvents(const std::vector<TempoEvent>& sortedEvents)
+{
+    tempoTrack.loadEvents(sortedEvents);
+
+    updateTempoDerivedData(std::numeric_limits<int64_t>::min());
+}
+
+void SongDocument::removeTempoEvent(size_t index)
+{
+    if (index >= tempoTrack.getEvents().size())
+    {
+        jassertfalse;
+        return;
+    }
+
+    const auto tick = tempoTrack.getEvents()[index].getTick();
+
+    tempoTrack.removeEvent(index);
+
+    updateTempoDerivedData(tick);
+}
+
+void SongDocument::replaceTempoEvent(size_t index, const TempoEvent& event)
+{
+    if (index >= tempoTrack.getEvents().size())
+    {
+        jassertfalse;
+        return;
+    }
+
+    const auto tick = std::min(tempoTrack.getEvents()[index].getTick(), event.getTick());
+
+    tempoTrack.replaceEvent(index, event);
+
+    updateTempoDerivedData(tick);
+}
+
+void SongDocument::moveTempoEvent(size_t index, int64_t newTick)
+{
+    if (index >= tempoTrack.getEvents().size())
+    {
+        jassertfalse;
+        return;
+    }
+
+    const auto tick = std::min(tempoTrack.getEvents()[index].getTick(), newTick);
+
+    tempoTrack.moveEvent(index, newTick);
+
+    updateTempoDerivedData(tick);
 }
 
-void SongDocument::addTempoEvent(int64_t tick, TempoEvent::TempoEventType type, int numerator, int denominator, double tempo)
+void SongDocument::updateTempoDerivedData(int64_t firstAffectedTick)
 {
-    tempoTrack.addEvent(TempoEvent(tick, type, numerator, denominator, tempo));
+    firstAffectedTick = tempoMap.rebuildFrom(tempoTrack, ticksPerQuarterNote, firstAffectedTick);
+
+    // Notes are placed by bar, so a change in the middle of a bar can move every note in that bar.
+    auto firstAffectedBarTick = firstAffectedTick;
+    if (firstAffectedTick > 0)
+    {
+        const auto& segment = tempoMap.findSegmentByTick(firstAffectedTick - 1);
+        const auto ticks_from_origin = (firstAffectedTick - segment.barOriginTick) / segment.ticksPerBar * segment.ticksPerBar;
+        firstAffectedBarTick = std::min(firstAffectedTick, segment.barOriginTick + ticks_from_origin);
+    }
+
+    // Only notes which end at or after the first affected bar can move.
+    // Scans the note off column only, other columns are touched for moved notes.
+    const auto& note_off_ticks = notes.getNoteOffTicks();
+    for (int slot = 0; slot < notes.size(); ++slot)
+    {
+        if (note_off_ticks[(size_t)slot] < firstAffectedBarTick)
+        {
+            continue;
+        }
+
+        const auto note = notes[slot];
+        const auto note_timing = note.getTiming();
+
+        const auto it_note_off = noteOffTicks.find(note_timing.noteOffTick);
+        if (it_note_off != noteOffTicks.end())
+        {
+            noteOffTicks.erase(it_note_off);
+        }
+        noteIntervalIndex.remove(note.getId(), note.getNoteNumber(), { note_timing.noteOnTick, note_timing.noteOffTick });
+
+        const auto new_note_timing = Calculator::calculateNoteTiming(*this, note.toNote());
+        notes.setTiming(slot, new_note_timing);
+        noteOffTicks.insert(new_note_timing.noteOffTick);
+        noteIntervalIndex.add(note.getId(), note.getNoteNumber(), { new_note_timing.noteOnTick, new_note_timing.noteOffTick });
+    }
+
+    const auto first_song_end_changed_tick = updateTotalLengthInTicks();
+    updateRevision(std::min(firstAffectedTick, first_song_end_changed_tick));
+
+    tempoMapListeners.listeners.call([this](TempoMapListener& listener) { listener.tempoMapChanged(*this); });
 }
 
 //==============================================================================
 void SongDocument::addNote(const Note& note)
 {
-    notes.add(note);
+    if (notes.contains(note.id) || !isValidNoteNumber(note.noteNumber))
+    {
+        jassertfalse;
+        return;
+    }
+
+    // Note may come with an id which this document didn't mint, e.g. when loaded.
+    noteIdAllocator.reserveUpTo(note.id);
+
+    const auto note_timing = Calculator::calculateNoteTiming(*this, note);
+    notes.add(note, note_timing);
+    noteOffTicks.insert(note_timing.noteOffTick);
+    noteIntervalIndex.add(note.id, note.noteNumber, { note_timing.noteOnTick, note_timing.noteOffTick });
+
+    updateRevision(updateTotalLengthInTicks());
+}
+
+void SongDocument::removeNote(int noteId)
+{
+    const auto slot = notes.findSlot(noteId);
+    if (!slot.has_value())
+    {
+        return;
+    }
+
+    const auto note = notes[slot.value()];
+    const auto note_timing = note.getTiming();
+
+    const auto it_note_off = noteOffTicks.find(note_timing.noteOffTick);
+    if (it_note_off != noteOffTicks.end())
+    {
+        noteOffTicks.erase(it_note_off);
+    }
+    noteIntervalIndex.remove(noteId, note.getNoteNumber(), { note_timing.noteOnTick, note_timing.noteOffTick });
+
+    notes.remove(slot.value());
+
+    updateRevision(updateTotalLengthInTicks());
+}
+
+void SongDocument::updateNotes(const juce::Array<Note>& updatedNotes)
+{
+    if (updatedNotes.isEmpty())
+    {
+        return;
+    }
+
+    for (const auto& updated_note : updatedNotes)
+    {
+        // The note may have been removed since it was copied.
+        const auto slot = notes.findSlot(updated_note.id);
+        if (!slot.has_value())
+        {
+            continue;
+        }
+
+        if (!isValidNoteNumber(updated_note.noteNumber))
+        {
+            jassertfalse;
+            continue;
+        }
+
+        const auto note_timing = notes[slot.value()].getTiming();
+        const auto it_note_off = noteOffTicks.find(note_timing.noteOffTick);
+        if (it_note_off != noteOffTicks.end())
+        {
+            noteOffTicks.erase(it_note_off);
+        }
+        noteIntervalIndex.remove(updated_note.id, notes[slot.value()].getNoteNumber(), { note_timing.noteOnTick, note_timing.noteOffTick });
+
+        const auto new_note_timing = Calculator::calculateNoteTiming(*this, updated_note);
+        notes.set(slot.value(), updated_note, new_note_timing);
+        noteOffTicks.insert(new_note_timing.noteOffTick);
+        noteIntervalIndex.add(updated_note.id, updated_note.noteNumber, { new_note_timing.noteOnTick, new_note_timing.noteOffTick });
+    }
+
+    updateRevision(updateTotalLengthInTicks());
+}
+
+//==============================================================================
+SongDocument::NoteTiming SongDocument::getNoteTiming(const Note& note) const
+{
+    const auto slot = notes.findSlot(note.id);
+    if (slot.has_value())
+    {
+        return notes[slot.value()].getTiming();
+    }
+
+    // Note which is not owned by this document.
+    return Calculator::calculateNoteTiming(*this, note);
+}
+
+std::optional<SongDocument::NoteView> SongDocument::findNoteById(int noteId) const
+{
+    const auto slot = notes.findSlot(noteId);
+    if (!slot.has_value())
+    {
+        return std::nullopt;
+    }
+
+    return notes[slot.value()];
+}
+
+std::vector<SongDocument::NoteView> SongDocument::findNotesInRange(juce::Range<int64_t> rangeInTicks) const
+{
+    return findNotesById(noteIntervalIndex.findOverlapping(rangeInTicks));
+}
+
+std::vector<SongDocument::NoteView> SongDocument::findNotesAtTick(int64_t tick) const
+{
+    return findNotesById(noteIntervalIndex.findContaining(tick));
+}
+
+std::vector<SongDocument::NoteView> SongDocument::findNotesInArea(juce::Range<int64_t> rangeInTicks, juce::Range<int> noteNumbers) const
+{
+    return findNotesById(noteIntervalIndex.findOverlapping(rangeInTicks, noteNumbers));
+}
+
+std::vector<SongDocument::NoteView> SongDocument::findNotesAt(int64_t tick, int noteNumber) const
+{
+    return findNotesById(noteIntervalIndex.findContaining(tick, noteNumber));
 }
 
-void SongDocument::removeNote(const Note* note)
+std::vector<SongDocument::NoteView> SongDocument::findNotesById(const std::vector<int>& noteIds) const
 {
-    notes.remove(note);
+    std::vector<NoteView> found_notes;
+    found_notes.reserve(noteIds.size());
+
+    for (const auto note_id : noteIds)
+    {
+        const auto note = findNoteById(note_id);
+        if (note.has_value())
+        {
+            found_notes.push_back(note.value());
+        }
+    }
+
+    return found_notes;
+}
+
+//==============================================================================
+int SongDocument::NoteView::getId() const { return store->ids[(size_t)slot]; }
+int SongDocument::NoteView::getNoteNumber() const { return store->noteNumbers[(size_t)slot]; }
+int SongDocument::NoteView::getVelocity() const { return store->velocities[(size_t)slot]; }
+const juce::String& SongDocument::NoteView::getLyric() const { return store->getLyricText(store->lyricIds[(size_t)slot]); }
+int SongDocument::NoteView::getLyricId() const { return store->lyricIds[(size_t)slot]; }
+SongDocument::NoteDuration SongDocument::NoteView::getDuration() const { return NoteDuration(store->durationsInTicks[(size_t)slot]); }
+SongDocument::NoteTiming SongDocument::NoteView::getTiming() const { return store->getTiming(slot); }
+
+SongDocument::MusicalTime SongDocument::NoteView::getStartTime() const
+{
+    const auto& start_position = store->startPositions[(size_t)slot];
+    return MusicalTime{ start_position.bar, start_position.beat, start_position.tick };
+}
+
+SongDocument::Note SongDocument::NoteView::toNote() const
+{
+    return Note(getId(), getStartTime(), getDuration(), getNoteNumber(), getVelocity(), getLyric());
 }
 
 //==============================================================================
-int64_t SongDocument::getTotalLengthInTicks() const
+std::optional<int> SongDocument::NoteStore::findSlot(int noteId) const
 {
-    if (notes.isEmpty())
+    const auto it_slot = slotsById.find(noteId);
+    if (it_slot == slotsById.end())
     {
-        // If there are no notes, return the last tempo event tick or minimumTotalLengthInTicks
-        return std::max<int64_t>(minimumTotalLengthInTicks, tempoTrack.getEvents().back().getTick());;
+        return std::nullopt;
     }
 
-    // Find the last note's end position
-    int64_t lastNoteTick = 0;
-    for (const auto& note : notes)
+    return it_slot->second;
+}
+
+std::vector<int> SongDocument::NoteStore::getSlotsInStartOrder() const
+{
+    std::vector<int> slots((size_t)size());
+    std::iota(slots.begin(), slots.end(), 0);
+
+    std::sort(slots.begin(), slots.end(), [this](int lhs, int rhs)
+        {
+            return std::tie(noteOnTicks[(size_t)lhs], ids[(size_t)lhs]) < std::tie(noteOnTicks[(size_t)rhs], ids[(size_t)rhs]);
+        });
+
+    return slots;
+}
+
+int SongDocument::NoteStore::add(const Note& note, const NoteTiming& timing)
+{
+    const auto slot = size();
+
+    ids.push_back(note.id);
+    startPositions.push_back({ 0, 0, 0 });
+    durationsInTicks.push_back(0);
+    noteNumbers.push_back(0);
+    velocities.push_back(0);
+    lyricIds.push_back(lyrics.acquire(note.lyric));
+    noteOnTicks.push_back(0);
+    noteOffTicks.push_back(0);
+    noteOnTimesInSeconds.push_back(0.0);
+    noteOffTimesInSeconds.push_back(0.0);
+
+    slotsById[note.id] = slot;
+
+    set(slot, note, timing);
+
+    return slot;
+}
+
+void SongDocument::NoteStore::set(int slot, const Note& note, const NoteTiming& timing)
+{
+    jassert(ids[(size_t)slot] == note.id);
+
+    const auto index = (size_t)slot;
+    startPositions[index] = { note.startTimeInMusicalTime.bar, note.startTimeInMusicalTime.beat, note.startTimeInMusicalTime.tick };
+    durationsInTicks[index] = note.duration.ticks;
+    noteNumbers[index] = note.noteNumber;
+    velocities[index] = note.velocity;
+    if (lyrics.getText(lyricIds[index]) != note.lyric)
+    {
+        // Acquire first, so a text whose last use is this note is not dropped and interned again.
+        const auto lyric_id = lyrics.acquire(note.lyric);
+        lyrics.release(lyricIds[index]);
+        lyricIds[index] = lyric_id;
+    }
+
+    setTiming(slot, timing);
+}
+
+void SongDocument::NoteStore::setTiming(int slot, const NoteTiming& timing)
+{
+    const auto index = (size_t)slot;
+    noteOnTicks[index] = timing.noteOnTick;
+    noteOffTicks[index] = timing.noteOffTick;
+    noteOnTimesInSeconds[index] = timing.noteOnTimeInSeconds;
+    noteOffTimesInSeconds[index] = timing.noteOffTimeInSeconds;
+}
+
+void SongDocument::NoteStore::remove(int slot)
+{
+    jassert(0 <= slot && slot < size());
+
+    // Swap and pop, only the last note changes its slot.
+    const auto index = (size_t)slot;
+    const auto last_index = ids.size() - 1;
+
+    slotsById.erase(ids[index]);
+    lyrics.release(lyricIds[index]);
+
+    if (index != last_index)
+    {
+        ids[index] = ids[last_index];
+        startPositions[index] = startPositions[last_index];
+        durationsInTicks[index] = durationsInTicks[last_index];
+        noteNumbers[index] = noteNumbers[last_index];
+        velocities[index] = velocities[last_index];
+        lyricIds[index] = lyricIds[last_index];
+        noteOnTicks[index] = noteOnTicks[last_index];
+        noteOffTicks[index] = noteOffTicks[last_index];
+        noteOnTimesInSeconds[index] = noteOnTimesInSeconds[last_index];
+        noteOffTimesInSeconds[index] = noteOffTimesInSeconds[last_index];
+
+        slotsById[ids[index]] = slot;
+    }
+
+    ids.pop_back();
+    startPositions.pop_back();
+    durationsInTicks.pop_back();
+    noteNumbers.pop_back();
+    velocities.pop_back();
+    lyricIds.pop_back();
+    noteOnTicks.pop_back();
+    noteOffTicks.pop_back();
+    noteOnTimesInSeconds.pop_back();
+    noteOffTimesInSeconds.pop_back();
+}
+
+SongDocument::NoteTiming SongDocument::NoteStore::getTiming(int slot) const
+{
+    const auto index = (size_t)slot;
+    return NoteTiming{ noteOnTicks[index], noteOffTicks[index], noteOnTimesInSeconds[index], noteOffTimesInSeconds[index] };
+}
+
+//==============================================================================
+juce::Range<int> SongDocument::NoteIdAllocator::allocateBlock(int numIds)
+{
+    jassert(numIds >= 0);
+
+    const auto first_id = nextId.fetch_add(numIds, std::memory_order_relaxed);
+    return juce::Range<int>(first_id, first_id + numIds);
+}
+
+void SongDocument::NoteIdAllocator::reserveUpTo(int noteId)
+{
+    auto next_id = nextId.load(std::memory_order_relaxed);
+    while (next_id <= noteId && !nextId.compare_exchange_weak(next_id, noteId + 1, std::memory_order_relaxed))
     {
-        const auto noteOffPosition =  Calculator::calculateNoteOffPosition(*this, note);
-        const int64_t noteTick = Calculator::barToTick(*this, note.startTimeInMusicalTime);
-        const int64_t noteEndTick = Calculator::barToTick(*this, noteOffPosition);
-        lastNoteTick = std::max(lastNoteTick, noteEndTick);
     }
+}
+
+//==============================================================================
+// Returns first tick affected by the move of song end, or max of int64_t when it didn't move.
+int64_t SongDocument::updateTotalLengthInTicks()
+{
+    const auto previousTotalLengthInTicks = totalLengthInTicks;
+
+    // Find the last note's end position
+    const int64_t lastNoteTick = noteOffTicks.empty() ? 0 : *noteOffTicks.rbegin();
 
     // Check if there's a tempo event after the last note
     const int64_t lastTempoEventTick = tempoTrack.getEvents().empty() ? 0 : tempoTrack.getEvents().back().getTick();
 
     // Return the maximum of last note end and last tempo event
-    return std::max<int64_t>(minimumTotalLengthInTicks, std::max<int64_t>(lastNoteTick, lastTempoEventTick));
+    totalLengthInTicks = std::max<int64_t>(minimumTotalLengthInTicks, std::max<int64_t>(lastNoteTick, lastTempoEventTick));
+
+    if (totalLengthInTicks == previousTotalLengthInTicks)
+    {
+        return std::numeric_limits<int64_t>::max();
+    }
+
+    return std::min(totalLengthInTicks, previousTotalLengthInTicks);
+}
+
+void SongDocument::updateRevision(int64_t firstChangedTick)
+{
+    if (revisionChanges.size() >= kMaxNumRevisionChanges)
+    {
+        revisionChanges.erase(revisionChanges.begin());
+    }
+    revisionChanges.push_back({ revision, firstChangedTick });
+
+    // Shared by all documents, so a revision never names two different contents.
+    static std::atomic<uint64_t> lastRevision{ 0 };
+    revision = ++lastRevision;
+}
+
+std::optional<int64_t> SongDocument::findFirstChangedTickSince(uint64_t sinceRevision) const
+{
+    if (sinceRevision == revision)
+    {
+        return std::numeric_limits<int64_t>::max();
+    }
+
+    auto first_changed_tick = std::numeric_limits<int64_t>::max();
+    for (auto it = revisionChanges.rbegin(); it != revisionChanges.rend(); ++it)
+    {
+        first_changed_tick = std::min(first_changed_tick, it->firstChangedTick);
+
+        if (it->previousRevision == sinceRevision)
+        {
+            return first_changed_tick;
+        }
+    }
+
+    return std::nullopt;
 }
 
 //==============================================================================
@@ -106,36 +535,35 @@ std::string SongDocument::dumpToString() const
             }
             break;
         }
+
+        if (event.hasTempo() && event.getTempoCurve() != TempoEvent::TempoCurve::kStep)
+        {
+            oss << "    Tempo Ramp: " << (event.getTempoCurve() == TempoEvent::TempoCurve::kLinear ? "Linear" : "Exponential") << "\n";
+        }
     }
     oss << "\n";
 
     // Notes
     oss << "Notes:\n";
-    for (const auto& note : notes)
+    for (const auto slot : notes.getSlotsInStartOrder())
     {
-        oss << "  Note ID " << note.id << ":\n";
-        oss << "    Start: Bar " << note.startTimeInMusicalTime.bar
-            << ", Beat " << note.startTimeInMusicalTime.beat
-            << ", Tick " << note.startTimeInMusicalTime.tick << "\n";
+        const auto note = notes[slot];
+        const auto start_time = note.getStartTime();
+        oss << "  Note ID " << note.getId() << ":\n";
+        oss << "    Start: Bar " << start_time.bar
+            << ", Beat " << start_time.beat
+            << ", Tick " << start_time.tick << "\n";
         oss << "    Duration: "
-            << note.duration.ticks << " ticks\n";
-        oss << "    Note Number: " << note.noteNumber << "\n";
-        oss << "    Velocity: " << note.velocity << "\n";
-        oss << "    Lyric: " << note.lyric << "\n";
-
-        const auto musical_time_note_on = note.startTimeInMusicalTime;
-        int64_t tickOnPosition = Calculator::barToTick(*this, musical_time_note_on);
-        oss << "    Absolute Tick On Position: " << tickOnPosition << " ticks\n";
-
-        const auto musical_time_note_off = cctn::song::SongDocument::Calculator::calculateNoteOffPosition(*this, note);
-        int64_t tickOffPosition = Calculator::barToTick(*this, musical_time_note_off);
-        oss << "    Absolute Tick Off Position: " << tickOffPosition << " ticks\n";
-
-        double startTime = Calculator::tickToAbsoluteTime(*this, Calculator::barToTick(*this, note.startTimeInMusicalTime));
-        oss << "    Absolute Start Time: " << startTime << " seconds\n";
-
-        double endTime = Calculator::tickToAbsoluteTime(*this, Calculator::barToTick(*this, musical_time_note_off));
-        oss << "    Absolute End Time: " << endTime << " seconds\n";
+            << note.getDuration().ticks << " ticks\n";
+        oss << "    Note Number: " << note.getNoteNumber() << "\n";
+        oss << "    Velocity: " << note.getVelocity() << "\n";
+        oss << "    Lyric: " << note.getLyric() << "\n";
+
+        const auto note_timing = getNoteTiming(note);
+        oss << "    Absolute Tick On Position: " << note_timing.noteOnTick << " ticks\n";
+        oss << "    Absolute Tick Off Position: " << note_timing.noteOffTick << " ticks\n";
+        oss << "    Absolute Start Time: " << note_timing.noteOnTimeInSeconds << " seconds\n";
+        oss << "    Absolute End Time: " << note_timing.noteOffTimeInSeconds << " seconds\n";
     }
 
     return oss.str();
@@ -161,6 +589,9 @@ juce::var SongDocument::toJson() const
     // Ticks per quarter note
     jsonDoc->setProperty("ticksPerQuarterNote", doc.getTicksPerQuarterNote());
 
+    // Next note id, so ids of deleted notes are not handed out again after loading
+    jsonDoc->setProperty("nextNoteId", doc.getNoteIdAllocator().getNextId());
+
     // Tempo Track
     juce::Array<juce::var> tempoTrack;
     for (const auto& event : doc.getTempoTrack().getEvents())
@@ -198,37 +629,54 @@ juce::var SongDocument::toJson() const
             break;
         }
 
+        switch (event.getTempoCurve())
+        {
+        case cctn::song::SongDocument::TempoEvent::TempoCurve::kLinear:
+            tempoEvent->setProperty("curve", "kLinear");
+            break;
+        case cctn::song::SongDocument::TempoEvent::TempoCurve::kExponential:
+            tempoEvent->setProperty("curve", "kExponential");
+            break;
+        case cctn::song::SongDocument::TempoEvent::TempoCurve::kStep:
+        default:
+            break;
+        }
+
         tempoTrack.add(tempoEvent);
     }
     jsonDoc->setProperty("tempoTrack", tempoTrack);
 
     // Notes
+    // Read straight from note columns, in start order so saved files don't depend on edit history.
+    const auto& note_store = doc.getNotes();
     juce::Array<juce::var> notes;
-    for (const auto& note : doc.getNotes())
+    notes.ensureStorageAllocated(note_store.size());
+    for (const auto note_slot : note_store.getSlotsInStartOrder())
     {
+        const auto slot = (size_t)note_slot;
         juce::DynamicObject* jsonNote = new juce::DynamicObject();
-        jsonNote->setProperty("id", note.id);
+        jsonNote->setProperty("id", note_store.getIds()[slot]);
 
+        const auto& start_position = note_store.getStartPositions()[slot];
         juce::DynamicObject* startTime = new juce::DynamicObject();
-        startTime->setProperty("bar", note.startTimeInMusicalTime.bar);
-        startTime->setProperty("beat", note.startTimeInMusicalTime.beat);
-        startTime->setProperty("tick", note.startTimeInMusicalTime.tick);
+        startTime->setProperty("bar", start_position.bar);
+        startTime->setProperty("beat", start_position.beat);
+        startTime->setProperty("tick", start_position.tick);
         jsonNote->setProperty("startTimeInMusicalTime", startTime);
 
         juce::DynamicObject* duration = new juce::DynamicObject();
-        duration->setProperty("ticks", note.duration.ticks);
+        duration->setProperty("ticks", note_store.getDurationsInTicks()[slot]);
         jsonNote->setProperty("duration", duration);
 
         // Add absolute tick position for note on
-        jsonNote->setProperty("absoluteTickOn", cctn::song::SongDocument::Calculator::barToTick(*this, note.startTimeInMusicalTime));
+        jsonNote->setProperty("absoluteTickOn", note_store.getNoteOnTicks()[slot]);
 
         // Add absolute tick position for note off
-        const auto musical_time_note_off = cctn::song::SongDocument::Calculator::calculateNoteOffPosition(*this, note);
-        jsonNote->setProperty("absoluteTickOff", cctn::song::SongDocument::Calculator::barToTick(*this, musical_time_note_off));
+        jsonNote->setProperty("absoluteTickOff", note_store.getNoteOffTicks()[slot]);
 
-        jsonNote->setProperty("noteNumber", note.noteNumber);
-        jsonNote->setProperty("velocity", note.velocity);
-        jsonNote->setProperty("lyric", note.lyric);
+        jsonNote->setProperty("noteNumber", note_store.getNoteNumbers()[slot]);
+        jsonNote->setProperty("velocity", note_store.getVelocities()[slot]);
+        jsonNote->setProperty("lyric", note_store.getLyricText(note_store.getLyricIds()[slot]));
 
         notes.add(jsonNote);
     }
@@ -237,263 +685,695 @@ juce::var SongDocument::toJson() const
     return jsonDoc;
 }
 
-//==============================================================================
-int64_t SongDocument::Calculator::barToTick(const cctn::song::SongDocument& document, const MusicalTime& musicalTime)
+std::unique_ptr<SongDocument> SongDocument::fromJson(const juce::var& json)
 {
-    if (musicalTime.bar < 1 || musicalTime.beat < 1 || musicalTime.tick < 0)
+    if ((int)json.getProperty("ticksPerQuarterNote", 0) != kDefaultTicksPerQuarterNote)
     {
-        // Invalid musical time
-        jassertfalse;
-        return 0;
+        return nullptr;
     }
 
-    int64_t accumulatedTicks = 0;
-    int currentBar = 1;
-    int currentBeat = 1;
-    int currentNumerator = 4;
-    int currentDenominator = 4;
-    int ticksPerQuarterNote = document.getTicksPerQuarterNote();
+    const auto* json_tempo_track = json.getProperty("tempoTrack", juce::var()).getArray();
+    const auto* json_notes = json.getProperty("notes", juce::var()).getArray();
+    if (json_tempo_track == nullptr || json_tempo_track->isEmpty() || json_notes == nullptr)
+    {
+        return nullptr;
+    }
 
-    const auto& events = document.getTempoTrack().getEvents();
-    auto eventIt = events.begin();
+    auto document = std::make_unique<SongDocument>();
 
-    while (eventIt != events.end() &&
-        (currentBar < musicalTime.bar ||
-            (currentBar == musicalTime.bar && currentBeat <= musicalTime.beat)))
-    {
-        const auto& event = *eventIt;
+    // Metadata
+    const auto json_metadata = json.getProperty("metadata", juce::var());
+    document->metadata.title = json_metadata.getProperty("title", juce::String()).toString();
+    document->metadata.artist = json_metadata.getProperty("artist", juce::String()).toString();
+    document->metadata.created = juce::Time::fromISO8601(json_metadata.getProperty("created", juce::String()).toString());
+    document->metadata.lastModified = juce::Time::fromISO8601(json_metadata.getProperty("lastModified", juce::String()).toString());
 
-        // Calculate ticks up to this event or musicalTime, whichever comes first
-        int64_t ticksToNextPoint = event.getTick() - accumulatedTicks;
-        int64_t ticksPerBar = currentNumerator * ticksPerQuarterNote * 4 / currentDenominator;
-        int64_t ticksPerBeat = ticksPerBar / currentNumerator;
+    // Tempo Track
+    std::vector<TempoEvent> tempo_events;
+    tempo_events.reserve((size_t)json_tempo_track->size());
+    for (const auto& json_event : *json_tempo_track)
+    {
+        const auto type_name = json_event.getProperty("type", juce::String()).toString();
 
-        while (currentBar < musicalTime.bar && ticksToNextPoint >= ticksPerBar)
+        TempoEvent::TempoEventType type;
+        if (type_name == "kTimeSignature")
         {
-            accumulatedTicks += ticksPerBar;
-            ticksToNextPoint -= ticksPerBar;
-            currentBar++;
+            type = TempoEvent::TempoEventType::kTimeSignature;
         }
-
-        while ((currentBar < musicalTime.bar ||
-            (currentBar == musicalTime.bar && currentBeat < musicalTime.beat))
-            && ticksToNextPoint >= ticksPerBeat)
+        else if (type_name == "kTempo")
         {
-            accumulatedTicks += ticksPerBeat;
-            ticksToNextPoint -= ticksPerBeat;
-            currentBeat++;
-            if (currentBeat > currentNumerator)
-            {
-                currentBar++;
-                currentBeat = 1;
-            }
+            type = TempoEvent::TempoEventType::kTempo;
         }
-
-        // If we've reached musicalTime, add remaining ticks and exit
-        if (currentBar == musicalTime.bar && currentBeat == musicalTime.beat)
+        else if (type_name == "kBoth")
         {
-            accumulatedTicks += musicalTime.tick;
-            return accumulatedTicks;
+            type = TempoEvent::TempoEventType::kBoth;
         }
-
-        // Otherwise, add ticks to this event and update time signature
-        accumulatedTicks += ticksToNextPoint;
-
-        if (event.getEventType() == TempoEvent::TempoEventType::kTimeSignature ||
-            event.getEventType() == TempoEvent::TempoEventType::kBoth)
+        else
         {
-            const auto timeSignature = event.getTimeSignature();
-            currentNumerator = timeSignature.numerator;
-            currentDenominator = timeSignature.denominator;
+            return nullptr;
         }
 
-        ++eventIt;
+        const auto curve_name = json_event.getProperty("curve", "kStep").toString();
+        const auto curve = (curve_name == "kLinear") ? TempoEvent::TempoCurve::kLinear
+            : (curve_name == "kExponential") ? TempoEvent::TempoCurve::kExponential
+            : TempoEvent::TempoCurve::kStep;
+
+        const auto json_time_signature = json_event.getProperty("timeSignature", juce::var());
+        tempo_events.emplace_back(
+            (int64_t)json_event.getProperty("tick", 0),
+            type,
+            (int)json_time_signature.getProperty("numerator", 4),
+            (int)json_time_signature.getProperty("denominator", 4),
+            (double)json_event.getProperty("tempo", 120.0),
+            curve);
     }
 
-    // If we've exited the loop, it means we've passed all events
-    // Calculate remaining ticks to musicalTime
-    int64_t ticksPerBar = currentNumerator * ticksPerQuarterNote * 4 / currentDenominator;
-    int64_t ticksPerBeat = ticksPerBar / currentNumerator;
+    // Older files don't list events in tick order.
+    std::stable_sort(tempo_events.begin(), tempo_events.end(), [](const TempoEvent& a, const TempoEvent& b)
+        {
+            return a.getTick() < b.getTick();
+        });
+    document->loadTempoEvents(tempo_events);
+
+    // Notes
+    // addNote reserves each loaded id, so minted ids never collide with them.
+    for (const auto& json_note : *json_notes)
+    {
+        const auto json_start_time = json_note.getProperty("startTimeInMusicalTime", juce::var());
+        const MusicalTime start_time{
+            (int)json_start_time.getProperty("bar", 1),
+            (int)json_start_time.getProperty("beat", 1),
+            (int)json_start_time.getProperty("tick", 0) };
+        const NoteDuration duration((int)json_note.getProperty("duration", juce::var()).getProperty("ticks", 0));
+
+        document->addNote(DataFactory::makeNote(
+            (int)json_note.getProperty("id", 0),
+            start_time,
+            duration,
+            (int)json_note.getProperty("noteNumber", 60),
+            (int)json_note.getProperty("velocity", 100),
+            json_note.getProperty("lyric", juce::String()).toString()));
+    }
 
-    accumulatedTicks += (musicalTime.bar - currentBar) * ticksPerBar;
-    accumulatedTicks += (musicalTime.beat - currentBeat) * ticksPerBeat;
-    accumulatedTicks += musicalTime.tick;
+    // Ids of notes deleted before saving stay retired.
+    if (json.hasProperty("nextNoteId"))
+    {
+        document->noteIdAllocator.reserveUpTo((int)json.getProperty("nextNoteId", 1) - 1);
+    }
 
-    return accumulatedTicks;
+    return document;
 }
 
-SongDocument::MusicalTime SongDocument::Calculator::tickToBar(const cctn::song::SongDocument& document, int64_t targetTick)
+//==============================================================================
+namespace
 {
-    MusicalTime result{ 1, 1, 0 }; // Start from bar 1, beat 1, tick 0
-    int64_t accumulatedTicks = 0;
-    int currentNumerator = 4;
-    int currentDenominator = 4;
-
-    for (const auto& event : document.tempoTrack.getEvents())
+    int64_t floorDivide(int64_t value, int64_t divisor)
     {
-        if (accumulatedTicks >= targetTick)
-            break;
-
-        int64_t ticksToEvent = event.getTick() - accumulatedTicks;
-        int64_t ticksToProcess = std::min(ticksToEvent, targetTick - accumulatedTicks);
+        const auto quotient = value / divisor;
+        return ((value % divisor != 0) && ((value < 0) != (divisor < 0))) ? quotient - 1 : quotient;
+    }
 
-        int64_t ticksPerBar = currentNumerator * document.ticksPerQuarterNote * 4 / currentDenominator;
-        int64_t ticksPerBeat = ticksPerBar / currentNumerator;
+    // floor(a * b / denominator) for 0 <= a, b < denominator, by binary long multiplication
+    // so that no intermediate value exceeds twice the denominator.
+    int64_t multiplyDivideFloorOfRemainders(int64_t a, int64_t b, int64_t denominator)
+    {
+        jassert(0 <= a && a < denominator && 0 <= b && b < denominator);
+        jassert(denominator <= (std::numeric_limits<int64_t>::max() >> 1));
 
-        // Process full bars
-        while (ticksToProcess >= ticksPerBar)
+        if (a == 0 || b <= std::numeric_limits<int64_t>::max() / a)
         {
-            result.bar++;
-            ticksToProcess -= ticksPerBar;
-            accumulatedTicks += ticksPerBar;
+            return (a * b) / denominator;
         }
 
-        // Process full beats
-        while (ticksToProcess >= ticksPerBeat)
+        int64_t quotient = 0;
+        int64_t remainder = 0;
+
+        for (int bit = 62; bit >= 0; --bit)
         {
-            result.beat++;
-            ticksToProcess -= ticksPerBeat;
-            accumulatedTicks += ticksPerBeat;
-            if (result.beat > currentNumerator)
+            quotient <<= 1;
+            remainder <<= 1;
+            if (remainder >= denominator)
+            {
+                remainder -= denominator;
+                ++quotient;
+            }
+
+            if (((b >> bit) & 1) != 0)
             {
-                result.bar++;
-                result.beat = 1;
+                remainder += a;
+                if (remainder >= denominator)
+                {
+                    remainder -= denominator;
+                    ++quotient;
+                }
             }
         }
 
-        // Add remaining ticks
-        result.tick = ticksToProcess;
-        accumulatedTicks += ticksToProcess;
+        return quotient;
+    }
 
-        // If we've reached or passed the target tick, we're done
-        if (accumulatedTicks >= targetTick)
-            break;
+    // floor(value * numerator / denominator) without overflow of the intermediate product.
+    int64_t multiplyDivideFloor(int64_t value, int64_t numerator, int64_t denominator)
+    {
+        jassert(numerator > 0 && denominator > 0);
 
-        // Update time signature if this event changes it
-        if (event.getEventType() == TempoEvent::TempoEventType::kTimeSignature ||
-            event.getEventType() == TempoEvent::TempoEventType::kBoth)
-        {
-            const auto timeSignature = event.getTimeSignature();
-            currentNumerator = timeSignature.numerator;
-            currentDenominator = timeSignature.denominator;
+        const auto common = std::gcd(numerator, denominator);
+        numerator /= common;
+        denominator /= common;
 
-            // Reset beat and tick for the new time signature
-            result.beat = 1;
-            result.tick = 0;
-        }
+        // value = q * denominator + r and numerator = nq * denominator + nr, with 0 <= r, nr < denominator.
+        const auto quotient = floorDivide(value, denominator);
+        const auto remainder = value - quotient * denominator;
+        const auto numerator_quotient = numerator / denominator;
+        const auto numerator_remainder = numerator % denominator;
+
+        return quotient * numerator
+            + remainder * numerator_quotient
+            + multiplyDivideFloorOfRemainders(remainder, numerator_remainder, denominator);
     }
+}
 
-    // If we've exited the loop and haven't reached the target tick,
-    // process any remaining ticks using the last known time signature
-    if (accumulatedTicks < targetTick)
+//==============================================================================
+// SongDocument::TempoMap
+//==============================================================================
+void SongDocument::TempoMap::rebuild(const TempoTrack& tempoTrack, int newTicksPerQuarterNote)
+{
+    rebuildFrom(tempoTrack, newTicksPerQuarterNote, std::numeric_limits<int64_t>::min());
+}
+
+int64_t SongDocument::TempoMap::rebuildFrom(const TempoTrack& tempoTrack, int newTicksPerQuarterNote, int64_t firstAffectedTick)
+{
+    if (newTicksPerQuarterNote != ticksPerQuarterNote)
     {
-        int64_t remainingTicks = targetTick - accumulatedTicks;
-        int64_t ticksPerBar = currentNumerator * document.ticksPerQuarterNote * 4 / currentDenominator;
-        int64_t ticksPerBeat = ticksPerBar / currentNumerator;
+        // All segments depend on resolution.
+        ticksPerQuarterNote = newTicksPerQuarterNote;
+        segments.clear();
+    }
+
+    const auto update_derived_values = [ticksPerQuarterNote = ticksPerQuarterNote](Segment& segment)
+        {
+            segment.ticksPerBar = segment.numerator * ticksPerQuarterNote * 4 / segment.denominator;
+            segment.ticksPerBeat = segment.ticksPerBar / segment.numerator;
+            segment.secondsPerTick = 60.0 / (segment.tempo * ticksPerQuarterNote);
+            segment.ticksPerSecond = (segment.tempo * ticksPerQuarterNote) / 60.0;
+            segment.tempoInMilliBpm = (int64_t)std::llround(segment.tempo * 1000.0);
+
+            const auto ramp_length = (double)(segment.rampEndTick - segment.startTick);
+            segment.rampRate = 0.0;
+
+            if (ramp_length <= 0.0)
+            {
+                return;
+            }
+
+            switch (segment.curve)
+            {
+            case TempoEvent::TempoCurve::kLinear:
+                // Tempo change per tick.
+                segment.rampRate = (segment.endTempo - segment.tempo) / ramp_length;
+                break;
+            case TempoEvent::TempoCurve::kExponential:
+                // Natural log of tempo ratio per tick.
+                segment.rampRate = std::log(segment.endTempo / segment.tempo) / ramp_length;
+                break;
+            case TempoEvent::TempoCurve::kStep:
+            default:
+                break;
+            }
+        };
+
+    // Segments which start before the first affected tick are still valid.
+    const auto it_first_affected_segment = std::lower_bound(segments.begin(), segments.end(), firstAffectedTick,
+        [](const Segment& segment, int64_t value)
+        {
+            return segment.startTick < value;
+        });
+    segments.erase(it_first_affected_segment, segments.end());
+
+    // Ramp depends on the next tempo event, so rebuild from the start of the ramp.
+    while (!segments.empty() && segments.back().curve != TempoEvent::TempoCurve::kStep)
+    {
+        firstAffectedTick = segments.back().startTick;
+        segments.pop_back();
+    }
+
+    const auto& events = tempoTrack.getEvents();
+    auto it_first_event = events.begin();
+
+    if (segments.empty())
+    {
+        // Default segment: 4/4, 120 BPM from tick 0.
+        Segment initial_segment;
+        update_derived_values(initial_segment);
+        segments.reserve(events.size() + 1);
+        segments.push_back(initial_segment);
+
+        firstAffectedTick = std::numeric_limits<int64_t>::min();
+    }
+    else
+    {
+        it_first_event = std::lower_bound(events.begin(), events.end(), firstAffectedTick,
+            [](const TempoEvent& event, int64_t value)
+            {
+                return event.getTick() < value;
+            });
+    }
+
+    for (auto it_event = it_first_event; it_event != events.end(); ++it_event)
+    {
+        const auto& event = *it_event;
+        const auto& previous = segments.back();
+        const int64_t ticks_from_previous = event.getTick() - previous.startTick;
+
+        Segment segment = previous;
+        segment.startTick = event.getTick();
+        segment.startTimeInSeconds = previous.startTimeInSeconds + previous.ticksToSecondsFromStart((double)ticks_from_previous);
+        segment.startBar = previous.barOriginBar + (int)((event.getTick() - previous.barOriginTick) / previous.ticksPerBar);
+
+        if (event.hasTempo())
+        {
+            segment.tempo = event.getTempo();
+            segment.curve = event.getTempoCurve();
+
+            segment.rampEndTick = segment.startTick;
+
+            if (segment.curve != TempoEvent::TempoCurve::kStep)
+            {
+                // Ramp reaches the tempo of the next tempo event.
+                const auto it_next_tempo = std::find_if(it_event + 1, events.end(),
+                    [&event](const TempoEvent& e)
+                    {
+                        return e.getTick() > event.getTick() && e.hasTempo();
+                    });
+
+                if (it_next_tempo != events.end())
+                {
+                    segment.endTempo = it_next_tempo->getTempo();
+                    segment.rampEndTick = it_next_tempo->getTick();
+                }
+            }
+        }
+        else if (previous.isRamp())
+        {
+            // Time signature change in the middle of a ramp continues the ramp.
+            segment.tempo = previous.getTempoAt((double)ticks_from_previous);
+        }
 
-        // Process full bars
-        result.bar += remainingTicks / ticksPerBar;
-        remainingTicks %= ticksPerBar;
+        if (event.hasTimeSignature())
+        {
+            const auto timeSignature = event.getTimeSignature();
+            segment.numerator = timeSignature.numerator;
+            segment.denominator = timeSignature.denominator;
 
-        // Process full beats
-        result.beat += remainingTicks / ticksPerBeat;
-        remainingTicks %= ticksPerBeat;
+            // Bar counting restarts from beat 1 at time signature change.
+            segment.barOriginTick = segment.startTick;
+            segment.barOriginBar = segment.startBar;
+        }
 
-        // Add remaining ticks
-        result.tick = remainingTicks;
+        update_derived_values(segment);
 
-        // Normalize beat if it exceeds the number of beats in a bar
-        if (result.beat > currentNumerator)
+        // Events on the same tick are merged into one segment.
+        if (ticks_from_previous == 0)
         {
-            result.bar += (result.beat - 1) / currentNumerator;
-            result.beat = ((result.beat - 1) % currentNumerator) + 1;
+            segments.back() = segment;
+        }
+        else
+        {
+            segments.push_back(segment);
         }
     }
 
-    return result;
+    return firstAffectedTick;
 }
 
-double SongDocument::Calculator::tickToAbsoluteTime(const cctn::song::SongDocument& document, int64_t targetTick)
+//==============================================================================
+double SongDocument::TempoMap::Segment::getTempoAt(double ticksFromStart) const
 {
-    double absoluteTime = 0.0;
-    int64_t currentTick = 0;
-    double currentTempo = 120.0; // Default tempo
+    switch (isRamp() ? curve : TempoEvent::TempoCurve::kStep)
+    {
+    case TempoEvent::TempoCurve::kLinear:
+        return tempo + rampRate * ticksFromStart;
+    case TempoEvent::TempoCurve::kExponential:
+        return tempo * std::exp(rampRate * ticksFromStart);
+    case TempoEvent::TempoCurve::kStep:
+    default:
+        return tempo;
+    }
+}
+
+double SongDocument::TempoMap::Segment::ticksToSecondsFromStart(double ticksFromStart) const
+{
+    switch (isRamp() ? curve : TempoEvent::TempoCurve::kStep)
+    {
+    case TempoEvent::TempoCurve::kLinear:
+        // Integral of 1 / (tempo + rate * x).
+        return secondsPerTick * tempo / rampRate * std::log1p(rampRate * ticksFromStart / tempo);
+    case TempoEvent::TempoCurve::kExponential:
+        // Integral of 1 / (tempo * exp(rate * x)).
+        return -secondsPerTick * std::expm1(-rampRate * ticksFromStart) / rampRate;
+    case TempoEvent::TempoCurve::kStep:
+    default:
+        return ticksFromStart * secondsPerTick;
+    }
+}
 
-    for (const auto& event : document.tempoTrack.getEvents())
+double SongDocument::TempoMap::Segment::secondsToTicksFromStart(double secondsFromStart) const
+{
+    switch (isRamp() ? curve : TempoEvent::TempoCurve::kStep)
     {
-        if (event.getTick() >= targetTick)
+    case TempoEvent::TempoCurve::kLinear:
+        return tempo / rampRate * std::expm1(rampRate * secondsFromStart / (secondsPerTick * tempo));
+    case TempoEvent::TempoCurve::kExponential:
+        return -std::log1p(-rampRate * secondsFromStart / secondsPerTick) / rampRate;
+    case TempoEvent::TempoCurve::kStep:
+    default:
+        return secondsFromStart * ticksPerSecond;
+    }
+}
+
+const SongDocument::TempoMap::Segment& SongDocument::TempoMap::findSegmentByTick(int64_t tick) const
+{
+    return segments[findSegmentIndexByTick(tick)];
+}
+
+const SongDocument::TempoMap::Segment& SongDocument::TempoMap::findSegmentByTime(double timeInSeconds) const
+{
+    return segments[findSegmentIndexByTime(timeInSeconds)];
+}
+
+const SongDocument::TempoMap::Segment& SongDocument::TempoMap::findSegmentByBar(int bar) const
+{
+    jassert(!segments.empty());
+
+    auto it = std::upper_bound(segments.begin(), segments.end(), bar,
+        [](int value, const Segment& segment)
         {
-            // Calculate time for remaining ticks at current tempo
-            double secondsPerTick = 60.0 / (currentTempo * document.ticksPerQuarterNote);
-            absoluteTime += (targetTick - currentTick) * secondsPerTick;
-            return absoluteTime;
-        }
+            return value < segment.startBar;
+        });
+
+    return (it == segments.begin()) ? *it : *(--it);
+}
+
+size_t SongDocument::TempoMap::findSegmentIndexByTick(int64_t tick) const
+{
+    jassert(!segments.empty());
 
-        if (event.getEventType() == TempoEvent::TempoEventType::kTempo ||
-            event.getEventType() == TempoEvent::TempoEventType::kBoth)
+    auto it = std::upper_bound(segments.begin(), segments.end(), tick,
+        [](int64_t value, const Segment& segment) 
         {
-            // Calculate time up to this tempo change
-            double secondsPerTick = 60.0 / (currentTempo * document.ticksPerQuarterNote);
-            absoluteTime += (event.getTick() - currentTick) * secondsPerTick;
+            return value < segment.startTick;
+        });
 
-            // Update current position and tempo
-            currentTick = event.getTick();
-            currentTempo = event.getTempo();
+    return (it == segments.begin()) ? 0 : (size_t)std::distance(segments.begin(), it) - 1;
+}
+
+size_t SongDocument::TempoMap::findSegmentIndexByTime(double timeInSeconds) const
+{
+    jassert(!segments.empty());
+
+    auto it = std::upper_bound(segments.begin(), segments.end(), timeInSeconds,
+        [](double value, const Segment& segment)
+        {
+            return value < segment.startTimeInSeconds;
+        });
+
+    return (it == segments.begin()) ? 0 : (size_t)std::distance(segments.begin(), it) - 1;
+}
+
+//==============================================================================
+double SongDocument::TempoMap::tickToAbsoluteTime(int64_t targetTick) const
+{
+    const auto& segment = findSegmentByTick(targetTick);
+
+    return segment.startTimeInSeconds + segment.ticksToSecondsFromStart((double)(targetTick - segment.startTick));
+}
+
+int64_t SongDocument::TempoMap::absoluteTimeToTick(double targetTime) const
+{
+    if (targetTime <= 0.0)
+        return 0;
+
+    const auto& segment = findSegmentByTime(targetTime);
+
+    return segment.startTick + static_cast<int64_t>(segment.secondsToTicksFromStart(targetTime - segment.startTimeInSeconds));
+}
+
+int64_t SongDocument::TempoMap::ticksToSamplesFromStart(const Segment& segment, int64_t ticksFromStart, int64_t sampleRate) const
+{
+    if (segment.isRamp())
+    {
+        return (int64_t)std::floor(segment.ticksToSecondsFromStart((double)ticksFromStart) * (double)sampleRate);
+    }
+
+    // samples per tick = 60 * sampleRate / (tempo * ticksPerQuarterNote)
+    return multiplyDivideFloor(ticksFromStart, 60 * 1000 * sampleRate, segment.tempoInMilliBpm * ticksPerQuarterNote);
+}
+
+int64_t SongDocument::TempoMap::tickToSamples(int64_t targetTick, double sampleRate) const
+{
+    const auto sample_rate = (int64_t)std::llround(sampleRate);
+    jassert(sample_rate > 0);
+
+    const auto segment_index = findSegmentIndexByTick(targetTick);
+
+    // Linear in the number of preceding segments, which keeps this free of any per sample rate cache.
+    int64_t start_in_samples = 0;
+    for (size_t i = 0; i < segment_index; ++i)
+    {
+        start_in_samples += ticksToSamplesFromStart(segments[i], segments[i + 1].startTick - segments[i].startTick, sample_rate);
+    }
+
+    const auto& segment = segments[segment_index];
+
+    return start_in_samples + ticksToSamplesFromStart(segment, targetTick - segment.startTick, sample_rate);
+}
+
+int64_t SongDocument::TempoMap::samplesToTick(int64_t targetSamples, double sampleRate) const
+{
+    const auto sample_rate = (int64_t)std::llround(sampleRate);
+    jassert(sample_rate > 0);
+    jassert(!segments.empty());
+
+    if (targetSamples < 0)
+        return 0;
+
+    // Last segment which starts at or before the sample.
+    size_t segment_index = 0;
+    int64_t start_in_samples = 0;
+    while (segment_index + 1 < segments.size())
+    {
+        const auto& current = segments[segment_index];
+        const auto next_start_in_samples = start_in_samples
+            + ticksToSamplesFromStart(current, segments[segment_index + 1].startTick - current.startTick, sample_rate);
+
+        if (next_start_in_samples > targetSamples)
+        {
+            break;
         }
+
+        start_in_samples = next_start_in_samples;
+        ++segment_index;
     }
 
-    // If target tick is beyond all tempo changes
-    double secondsPerTick = 60.0 / (currentTempo * document.ticksPerQuarterNote);
-    absoluteTime += (targetTick - currentTick) * secondsPerTick;
+    const auto& segment = segments[segment_index];
+    const auto samples_from_start = targetSamples - start_in_samples;
 
-    return absoluteTime;
+    if (segment.isRamp())
+    {
+        // Correct rounding error of the inverse so that this is the last tick which starts at or before the sample.
+        auto ticks_from_start = (int64_t)std::floor(segment.secondsToTicksFromStart((double)samples_from_start / (double)sample_rate));
+        while (ticks_from_start > 0 && ticksToSamplesFromStart(segment, ticks_from_start, sample_rate) > samples_from_start)
+        {
+            --ticks_from_start;
+        }
+        while (ticksToSamplesFromStart(segment, ticks_from_start + 1, sample_rate) <= samples_from_start)
+        {
+            ++ticks_from_start;
+        }
+        return segment.startTick + ticks_from_start;
+    }
+
+    // Last tick which starts at or before the sample: ceil((samples + 1) / samplesPerTick) - 1
+    return segment.startTick - multiplyDivideFloor(-(samples_from_start + 1), segment.tempoInMilliBpm * ticksPerQuarterNote, 60 * 1000 * sample_rate) - 1;
 }
 
-int64_t SongDocument::Calculator::absoluteTimeToTick(const cctn::song::SongDocument& document, double targetTime)
+//==============================================================================
+int64_t SongDocument::Calculator::barToTick(const cctn::song::SongDocument& document, const MusicalTime& musicalTime)
 {
-    if (targetTime <= 0.0)
+    if (musicalTime.bar < 1 || musicalTime.beat < 1 || musicalTime.tick < 0)
+    {
+        // Invalid musical time
+        jassertfalse;
         return 0;
+    }
+
+    const auto& segment = document.tempoMap.findSegmentByBar(musicalTime.bar);
 
-    int64_t resultTick = 0;
-    double currentTime = 0.0;
-    double currentTempo = 120.0; // Default tempo
-    int64_t lastEventTick = 0;
+    // Bars and beats are counted from the bar where current time signature takes effect.
+    return segment.barOriginTick
+        + (int64_t)(musicalTime.bar - segment.barOriginBar) * segment.ticksPerBar
+        + (int64_t)(musicalTime.beat - 1) * segment.ticksPerBeat
+        + musicalTime.tick;
+}
+
+SongDocument::MusicalTime SongDocument::Calculator::tickToBar(const cctn::song::SongDocument& document, int64_t targetTick)
+{
+    MusicalTime result{ 1, 1, 0 }; // Start from bar 1, beat 1, tick 0
 
-    for (const auto& event : document.tempoTrack.getEvents())
+    if (targetTick <= 0)
     {
-        if (event.getEventType() == TempoEvent::TempoEventType::kTempo ||
-            event.getEventType() == TempoEvent::TempoEventType::kBoth)
+        return result;
+    }
+
+    const auto& segment = document.tempoMap.findSegmentByTick(targetTick);
+
+    // Bars and beats are counted from the bar where current time signature takes effect.
+    const int64_t ticksFromBarOrigin = targetTick - segment.barOriginTick;
+    const int64_t ticksInBar = ticksFromBarOrigin % segment.ticksPerBar;
+
+    result.bar = segment.barOriginBar + (int)(ticksFromBarOrigin / segment.ticksPerBar);
+    result.beat = 1 + (int)(ticksInBar / segment.ticksPerBeat);
+    result.tick = (int)(ticksInBar % segment.ticksPerBeat);
+
+    return result;
+}
+
+double SongDocument::Calculator::tickToAbsoluteTime(const cctn::song::SongDocument& document, int64_t targetTick)
+{
+    return document.tempoMap.tickToAbsoluteTime(targetTick);
+}
+
+int64_t SongDocument::Calculator::absoluteTimeToTick(const cctn::song::SongDocument& document, double targetTime)
+{
+    return document.tempoMap.absoluteTimeToTick(targetTime);
+}
+
+//==============================================================================
+int64_t SongDocument::Calculator::tickToSamples(const cctn::song::SongDocument& document, int64_t targetTick, double sampleRate)
+{
+    return document.tempoMap.tickToSamples(targetTick, sampleRate);
+}
+
+int64_t SongDocument::Calculator::samplesToTick(const cctn::song::SongDocument& document, int64_t targetSamples, double sampleRate)
+{
+    return document.tempoMap.samplesToTick(targetSamples, sampleRate);
+}
+
+//==============================================================================
+void SongDocument::Calculator::ticksToAbsoluteTimes(const cctn::song::SongDocument& document, const int64_t* sortedTicks, double* destTimesInSeconds, int numValues)
+{
+    jassert(std::is_sorted(sortedTicks, sortedTicks + numValues));
+
+    const auto& segments = document.tempoMap.getSegments();
+
+    int index = 0;
+    size_t segment_index = (numValues > 0) ? document.tempoMap.findSegmentIndexByTick(sortedTicks[0]) : 0;
+
+    while (index < numValues)
+    {
+        const auto& segment = segments[segment_index];
+
+        // Find the run of values which belongs to this segment.
+        int index_end = numValues;
+        if (segment_index + 1 < segments.size())
         {
-            double secondsPerTick = 60.0 / (currentTempo * document.ticksPerQuarterNote);
-            double eventTime = currentTime + (event.getTick() - lastEventTick) * secondsPerTick;
+            const auto next_segment_start_tick = segments[segment_index + 1].startTick;
+            index_end = (int)std::distance(sortedTicks, std::lower_bound(sortedTicks + index, sortedTicks + numValues, next_segment_start_tick));
+        }
 
-            if (eventTime >= targetTime)
+        const int num_in_segment = index_end - index;
+        if (segment.isRamp())
+        {
+            for (int i = index; i < index_end; ++i)
+            {
+                destTimesInSeconds[i] = segment.startTimeInSeconds + segment.ticksToSecondsFromStart((double)(sortedTicks[i] - segment.startTick));
+            }
+        }
+        else if (num_in_segment > 0)
+        {
+            for (int i = index; i < index_end; ++i)
             {
-                // Target time is within this tempo section
-                resultTick = lastEventTick + static_cast<int64_t>((targetTime - currentTime) / secondsPerTick);
-                return resultTick;
+                destTimesInSeconds[i] = (double)(sortedTicks[i] - segment.startTick);
             }
 
-            // Update current position, time, and tempo
-            currentTime = eventTime;
-            lastEventTick = event.getTick();
-            currentTempo = event.getTempo();
+            juce::FloatVectorOperations::multiply(destTimesInSeconds + index, segment.secondsPerTick, num_in_segment);
+            juce::FloatVectorOperations::add(destTimesInSeconds + index, segment.startTimeInSeconds, num_in_segment);
         }
+
+        index = index_end;
+        ++segment_index;
     }
+}
+
+void SongDocument::Calculator::absoluteTimesToTicks(const cctn::song::SongDocument& document, const double* sortedTimesInSeconds, int64_t* destTicks, int numValues)
+{
+    jassert(std::is_sorted(sortedTimesInSeconds, sortedTimesInSeconds + numValues));
+
+    const auto& segments = document.tempoMap.getSegments();
+
+    // Non-positive time is clamped to tick 0.
+    int index = 0;
+    while (index < numValues && sortedTimesInSeconds[index] <= 0.0)
+    {
+        destTicks[index] = 0;
+        ++index;
+    }
+
+    if (index == numValues)
+    {
+        return;
+    }
+
+    size_t segment_index = document.tempoMap.findSegmentIndexByTime(sortedTimesInSeconds[index]);
+
+    // Fixed size working buffer to avoid allocation.
+    constexpr int kChunkSize = 256;
+    double offsets_in_ticks[kChunkSize];
+
+    while (index < numValues)
+    {
+        const auto& segment = segments[segment_index];
+
+        // Find the run of values which belongs to this segment.
+        int index_end = numValues;
+        if (segment_index + 1 < segments.size())
+        {
+            const auto next_segment_start_time = segments[segment_index + 1].startTimeInSeconds;
+            index_end = (int)std::distance(sortedTimesInSeconds, std::lower_bound(sortedTimesInSeconds + index, sortedTimesInSeconds + numValues, next_segment_start_time));
+        }
+
+        if (segment.isRamp())
+        {
+            for (int i = index; i < index_end; ++i)
+            {
+                destTicks[i] = segment.startTick + static_cast<int64_t>(segment.secondsToTicksFromStart(sortedTimesInSeconds[i] - segment.startTimeInSeconds));
+            }
+        }
+        else
+        {
+            for (int chunk_start = index; chunk_start < index_end; chunk_start += kChunkSize)
+            {
+                const int num_in_chunk = std::min(kChunkSize, index_end - chunk_start);
 
-    // If target time is beyond all tempo changes
-    double secondsPerTick = 60.0 / (currentTempo * document.ticksPerQuarterNote);
-    resultTick = lastEventTick + static_cast<int64_t>((targetTime - currentTime) / secondsPerTick);
+                juce::FloatVectorOperations::copy(offsets_in_ticks, sortedTimesInSeconds + chunk_start, num_in_chunk);
+                juce::FloatVectorOperations::add(offsets_in_ticks, -segment.startTimeInSeconds, num_in_chunk);
+                juce::FloatVectorOperations::multiply(offsets_in_ticks, segment.ticksPerSecond, num_in_chunk);
 
-    return resultTick;
+                for (int i = 0; i < num_in_chunk; ++i)
+                {
+                    destTicks[chunk_start + i] = segment.startTick + static_cast<int64_t>(offsets_in_ticks[i]);
+                }
+            }
+        }
+
+        index = index_end;
+        ++segment_index;
+    }
 }
 
 int64_t SongDocument::Calculator::noteLengthToTicks(const cctn::song::SongDocument& document, const NoteLength resolution)
 {
-    double noteLengthsPerQuarterNote = cctn::song::getNoteLengthsPerQuarterNote(resolution);
-    int64_t ticksPerNoteLength = static_cast<int64_t>(document.ticksPerQuarterNote / noteLengthsPerQuarterNote);
-
-    return ticksPerNoteLength;
+    return cctn::song::getTicksPerNoteLength(resolution, document.ticksPerQuarterNote);
 }
 
 //==============================================================================
@@ -514,104 +1394,291 @@ SongDocument::MusicalTime SongDocument::Calculator::calculateNoteOffPosition(con
     return noteOffMusicalTime;
 }
 
-SongDocument::BeatTimePoints SongDocument::BeatTimePointsFactory::makeBeatTimePoints(const cctn::song::SongDocument& document, NoteLength resolution)
+SongDocument::NoteTiming SongDocument::Calculator::calculateNoteTiming(const SongDocument& document, const Note& note)
 {
-    BeatTimePoints beatPoints;
-    const auto& tempoTrack = document.getTempoTrack();
-    const auto& events = tempoTrack.getEvents();
-    int ticksPerQuarterNote = document.getTicksPerQuarterNote();
+    NoteTiming result;
+    result.noteOnTick = barToTick(document, note.startTimeInMusicalTime);
+    result.noteOffTick = barToTick(document, calculateNoteOffPosition(document, note));
+    result.noteOnTimeInSeconds = tickToAbsoluteTime(document, result.noteOnTick);
+    result.noteOffTimeInSeconds = tickToAbsoluteTime(document, result.noteOffTick);
+
+    return result;
+}
 
-    double currentTime = 0.0;
-    int64_t currentTick = 0;
-    double currentTempo = 120.0; // Default tempo
-    int currentNumerator = 4;
-    int currentDenominator = 4;
+//==============================================================================
+template <int64_t FixedTicksPerStep>
+void SongDocument::BeatTimePointsFactory::appendBeatTimePoints(const cctn::song::SongDocument& document, int64_t ticksPerStep, juce::Range<int64_t> rangeInTicks, size_t maxNumPoints, BeatTimePoints& dest)
+{
+    static_assert(FixedTicksPerStep >= 0, "Step must be positive, or kVariableStep");
+    jassert(FixedTicksPerStep == kVariableStep || ticksPerStep == FixedTicksPerStep);
 
-    auto eventIt = events.begin();
+    const int64_t ticks_per_step = (FixedTicksPerStep != kVariableStep) ? FixedTicksPerStep : ticksPerStep;
+    jassert(ticks_per_step > 0);
 
-    double noteLengthsPerQuarterNote = cctn::song::getNoteLengthsPerQuarterNote(resolution);
-    double secondsPerQuarterNote = 60.0 / currentTempo;
-    double secondsPerNoteLength = secondsPerQuarterNote / noteLengthsPerQuarterNote;
-    int64_t ticksPerNoteLength = static_cast<int64_t>(ticksPerQuarterNote / noteLengthsPerQuarterNote);
+    const auto& segments = document.tempoMap.getSegments();
+    const int64_t range_start = std::max<int64_t>(rangeInTicks.getStart(), 0);
+    const int64_t range_end = rangeInTicks.getEnd();
 
-    while (true)
+    if (range_start >= range_end || maxNumPoints == 0)
+    {
+        return;
+    }
+
+    size_t num_points = 0;
+
+    for (auto segment_index = document.tempoMap.findSegmentIndexByTick(range_start); segment_index < segments.size(); ++segment_index)
     {
-        // Check if we've reached the next tempo or time signature change
-        while (eventIt != events.end() && currentTick >= eventIt->getTick())
+        const auto& segment = segments[segment_index];
+        if (segment.startTick >= range_end)
         {
-            if (eventIt->getEventType() == TempoEvent::TempoEventType::kTempo ||
-                eventIt->getEventType() == TempoEvent::TempoEventType::kBoth)
-            {
-                currentTempo = eventIt->getTempo();
-                secondsPerQuarterNote = 60.0 / currentTempo;
-                secondsPerNoteLength = secondsPerQuarterNote / noteLengthsPerQuarterNote;
-            }
-            if (eventIt->getEventType() == TempoEvent::TempoEventType::kTimeSignature ||
-                eventIt->getEventType() == TempoEvent::TempoEventType::kBoth)
+            break;
+        }
+
+        const int64_t segment_end = (segment_index + 1 < segments.size()) ? segments[segment_index + 1].startTick : std::numeric_limits<int64_t>::max();
+        const int64_t window_start = std::max(range_start, segment.startTick);
+        const int64_t window_end = std::min(range_end, segment_end);
+
+        // Steps are counted from each bar line of current time signature.
+        int64_t bar_index = (window_start - segment.barOriginTick) / segment.ticksPerBar;
+        int64_t bar_start_tick = segment.barOriginTick + bar_index * segment.ticksPerBar;
+        int64_t ticks_in_bar = (window_start - bar_start_tick + ticks_per_step - 1) / ticks_per_step * ticks_per_step;
+
+        while (bar_start_tick < window_end)
+        {
+            for (; ticks_in_bar < segment.ticksPerBar; ticks_in_bar += ticks_per_step)
             {
-                const auto timeSignature = eventIt->getTimeSignature();
-                currentNumerator = timeSignature.numerator;
-                currentDenominator = timeSignature.denominator;
+                const int64_t tick = bar_start_tick + ticks_in_bar;
+                if (tick >= window_end)
+                {
+                    break;
+                }
+
+                const MusicalTime musical_time{
+                    segment.barOriginBar + (int)bar_index,
+                    1 + (int)(ticks_in_bar / segment.ticksPerBeat),
+                    (int)(ticks_in_bar % segment.ticksPerBeat) };
+
+                dest.push_back({ tick, musical_time, segment.startTimeInSeconds + segment.ticksToSecondsFromStart((double)(tick - segment.startTick)) });
+
+                if (++num_points >= maxNumPoints)
+                {
+                    return;
+                }
             }
-            ++eventIt;
+
+            ++bar_index;
+            bar_start_tick += segment.ticksPerBar;
+            ticks_in_bar = 0;
         }
+    }
+}
+
+template <int TicksPerQuarterNote, size_t... NoteLengthIndices>
+constexpr std::array<SongDocument::BeatTimePointsFactory::GridKernel, kNumNoteLengths> SongDocument::BeatTimePointsFactory::makeGridKernelTable(std::index_sequence<NoteLengthIndices...>)
+{
+    return { { &appendBeatTimePoints<cctn::song::getTicksPerNoteLength((NoteLength)NoteLengthIndices, TicksPerQuarterNote)>... } };
+}
+
+SongDocument::BeatTimePointsFactory::GridKernel SongDocument::BeatTimePointsFactory::getGridKernel(NoteLength resolution, int ticksPerQuarterNote)
+{
+    static constexpr auto kernels_for_default_resolution = makeGridKernelTable<kDefaultTicksPerQuarterNote>(std::make_index_sequence<kNumNoteLengths>{});
+
+    if (ticksPerQuarterNote == kDefaultTicksPerQuarterNote)
+    {
+        return kernels_for_default_resolution[(size_t)resolution];
+    }
+
+    return &appendBeatTimePoints<kVariableStep>;
+}
+
+//==============================================================================
+int64_t SongDocument::BeatTimePointsFactory::getEndOfGridInTicks(const cctn::song::SongDocument& document)
+{
+    // Cover all tempo events and notes.
+    const auto& events = document.getTempoTrack().getEvents();
+    return std::max(document.getTotalLengthInTicks(), events.empty() ? (int64_t)0 : events.back().getTick());
+}
 
-        // Convert current tick to MusicalTime
-        const MusicalTime musicalTime = cctn::song::SongDocument::Calculator::tickToBar(document, currentTick);
+void SongDocument::BeatTimePointsFactory::appendBeatTimePointsToEnd(const cctn::song::SongDocument& document, NoteLength resolution, int64_t startTick, BeatTimePoints& dest)
+{
+    const auto kernel = getGridKernel(resolution, document.getTicksPerQuarterNote());
+    const auto ticks_per_step = cctn::song::getTicksPerNoteLength(resolution, document.getTicksPerQuarterNote());
+    const auto end_tick = getEndOfGridInTicks(document);
 
-        // Add BeatTimePoint
-        beatPoints.push_back({ currentTick, musicalTime, currentTime });
+    dest.reserve(dest.size() + (size_t)(std::max<int64_t>(end_tick - startTick, 0) / ticks_per_step) + 2);
 
-        // Move to next beat point
-        currentTick += ticksPerNoteLength;
-        currentTime += secondsPerNoteLength;
+    kernel(document, ticks_per_step, { startTick, end_tick }, std::numeric_limits<size_t>::max(), dest);
 
-        // Convert current tick to MusicalTime
-        MusicalTime next_musical_time = cctn::song::SongDocument::Calculator::tickToBar(document, currentTick);
+    // Add tail BeatTimePoint
+    kernel(document, ticks_per_step, { end_tick, std::numeric_limits<int64_t>::max() }, 1, dest);
+}
+
+SongDocument::BeatTimePoints SongDocument::BeatTimePointsFactory::makeBeatTimePoints(const cctn::song::SongDocument& document, NoteLength resolution)
+{
+    BeatTimePoints beatPoints;
+    appendBeatTimePointsToEnd(document, resolution, 0, beatPoints);
 
-        // In case of bar is move to next bar and not equal to first beat of bar.
-        if (next_musical_time.bar != musicalTime.bar && next_musical_time.beat != 1)
+    return beatPoints;
+}
+
+SongDocument::BeatTimePoints SongDocument::BeatTimePointsFactory::patchBeatTimePoints(const cctn::song::SongDocument& document, NoteLength resolution, const BeatTimePoints& previousPoints, int64_t firstChangedTick)
+{
+    // Tail point is always regenerated.
+    const auto start_tick = std::max<int64_t>(std::min(firstChangedTick, getEndOfGridInTicks(document)), 0);
+
+    const auto it_first_changed = std::lower_bound(previousPoints.begin(), previousPoints.end(), start_tick,
+        [](const BeatTimePoint& point, int64_t tick)
         {
-            next_musical_time.beat = 1;
-            next_musical_time.tick = 0;
+            return point.absoluteTicks < tick;
+        });
 
-            currentTick = cctn::song::SongDocument::Calculator::barToTick(document, next_musical_time);
-            currentTime = cctn::song::SongDocument::Calculator::tickToAbsoluteTime(document, currentTick);
-        }
+    const auto ticks_per_step = cctn::song::getTicksPerNoteLength(resolution, document.getTicksPerQuarterNote());
+    const auto num_kept_points = (size_t)std::distance(previousPoints.begin(), it_first_changed);
+
+    BeatTimePoints beatPoints;
+    beatPoints.reserve(num_kept_points + (size_t)((getEndOfGridInTicks(document) - start_tick) / ticks_per_step) + 2);
+    beatPoints.insert(beatPoints.end(), previousPoints.begin(), it_first_changed);
 
-        // Check if we've reached the end of the song
-        if (eventIt == events.end() && currentTick >= document.getTotalLengthInTicks())
+    appendBeatTimePointsToEnd(document, resolution, start_tick, beatPoints);
+
+    return beatPoints;
+}
+
+SongDocument::BeatTimePoints SongDocument::BeatTimePointsFactory::makeBeatTimePointsInRange(const cctn::song::SongDocument& document, NoteLength resolution, juce::Range<int64_t> rangeInTicks)
+{
+    const auto kernel = getGridKernel(resolution, document.getTicksPerQuarterNote());
+    const auto ticks_per_step = cctn::song::getTicksPerNoteLength(resolution, document.getTicksPerQuarterNote());
+
+    BeatTimePoints beatPoints;
+    kernel(document, ticks_per_step, rangeInTicks, std::numeric_limits<size_t>::max(), beatPoints);
+
+    return beatPoints;
+}
+
+SongDocument::BeatTimePoints SongDocument::BeatTimePointsFactory::makeBeatTimePointsInTimeRange(const cctn::song::SongDocument& document, NoteLength resolution, juce::Range<double> rangeInSeconds)
+{
+    const auto& tempo_map = document.getTempoMap();
+    const juce::Range<int64_t> range_in_ticks{ tempo_map.absoluteTimeToTick(rangeInSeconds.getStart()), tempo_map.absoluteTimeToTick(rangeInSeconds.getEnd()) + 2 };
+
+    auto beatPoints = makeBeatTimePointsInRange(document, resolution, range_in_ticks);
+
+    // Tick range is widened for rounding of time to tick, so trim by exact time.
+    beatPoints.erase(std::remove_if(beatPoints.begin(), beatPoints.end(),
+        [rangeInSeconds](const BeatTimePoint& point)
         {
-            break;
-        }
-    }
+            return point.absoluteTimeInSeconds < rangeInSeconds.getStart() || point.absoluteTimeInSeconds > rangeInSeconds.getEnd();
+        }),
+        beatPoints.end());
 
-    // Add tail BeatTimePoint
+    return beatPoints;
+}
+
+SongDocument::BeatTimePointIterator SongDocument::BeatTimePointsFactory::makeBeatTimePointIterator(const cctn::song::SongDocument& document, NoteLength resolution, int64_t startTick)
+{
+    return makeBeatTimePointIterator(document.getTempoMap(), resolution, startTick);
+}
+
+SongDocument::BeatTimePointIterator SongDocument::BeatTimePointsFactory::makeBeatTimePointIteratorAtTime(const cctn::song::SongDocument& document, NoteLength resolution, double startTimeInSeconds)
+{
+    return makeBeatTimePointIteratorAtTime(document.getTempoMap(), resolution, startTimeInSeconds);
+}
+
+SongDocument::BeatTimePointIterator SongDocument::BeatTimePointsFactory::makeBeatTimePointIterator(const TempoMap& tempoMap, NoteLength resolution, int64_t startTick)
+{
+    return BeatTimePointIterator(tempoMap, cctn::song::getTicksPerNoteLength(resolution, tempoMap.getTicksPerQuarterNote()), startTick);
+}
+
+SongDocument::BeatTimePointIterator SongDocument::BeatTimePointsFactory::makeBeatTimePointIteratorAtTime(const TempoMap& tempoMap, NoteLength resolution, double startTimeInSeconds)
+{
+    // Time to tick rounds down, start one tick earlier and skip by exact time.
+    const auto start_tick = tempoMap.absoluteTimeToTick(startTimeInSeconds) - 1;
+
+    auto it = makeBeatTimePointIterator(tempoMap, resolution, start_tick);
+    while (it->absoluteTimeInSeconds < startTimeInSeconds)
     {
-        const MusicalTime musicalTime = cctn::song::SongDocument::Calculator::tickToBar(document, currentTick);
-        beatPoints.push_back({ currentTick, musicalTime, currentTime });
+        ++it;
     }
 
-    return beatPoints;
+    return it;
 }
 
 //==============================================================================
-namespace
+SongDocument::BeatTimePointIterator::BeatTimePointIterator(const TempoMap& tempoMap, int64_t newTicksPerStep, int64_t startTick)
+    : segments(&tempoMap.getSegments())
+    , ticksPerStep(newTicksPerStep)
+{
+    jassert(ticksPerStep > 0);
+    jassert(!segments->empty());
+
+    const auto start_tick = std::max<int64_t>(startTick, 0);
+
+    enterSegment(tempoMap.findSegmentIndexByTick(start_tick), start_tick);
+    settle();
+}
+
+SongDocument::BeatTimePointIterator& SongDocument::BeatTimePointIterator::operator++()
+{
+    ticksInBar += ticksPerStep;
+    settle();
+
+    return *this;
+}
+
+void SongDocument::BeatTimePointIterator::enterSegment(size_t index, int64_t fromTick)
+{
+    const auto& segment = (*segments)[index];
+
+    segmentIndex = index;
+    segmentEndTick = (index + 1 < segments->size()) ? (*segments)[index + 1].startTick : std::numeric_limits<int64_t>::max();
+
+    // Same stepping as appendBeatTimePoints, counted from each bar line.
+    barIndex = (fromTick - segment.barOriginTick) / segment.ticksPerBar;
+    barStartTick = segment.barOriginTick + barIndex * segment.ticksPerBar;
+    ticksInBar = (fromTick - barStartTick + ticksPerStep - 1) / ticksPerStep * ticksPerStep;
+}
+
+void SongDocument::BeatTimePointIterator::settle()
+{
+    while (true)
+    {
+        const auto& segment = (*segments)[segmentIndex];
+
+        if (ticksInBar >= segment.ticksPerBar)
+        {
+            ++barIndex;
+            barStartTick += segment.ticksPerBar;
+            ticksInBar = 0;
+        }
+
+        const int64_t tick = barStartTick + ticksInBar;
+        if (tick < segmentEndTick)
+        {
+            current.absoluteTicks = tick;
+            current.musicalTime.bar = segment.barOriginBar + (int)barIndex;
+            current.musicalTime.beat = 1 + (int)(ticksInBar / segment.ticksPerBeat);
+            current.musicalTime.tick = (int)(ticksInBar % segment.ticksPerBeat);
+            current.absoluteTimeInSeconds = segment.startTimeInSeconds + segment.ticksToSecondsFromStart((double)(tick - segment.startTick));
+            return;
+        }
+
+        enterSegment(segmentIndex + 1, segmentEndTick);
+    }
+}
+
+//==============================================================================
+SongDocument::Note SongDocument::DataFactory::makeNote(cctn::song::SongDocument& document, const MusicalTime& startTime, const NoteDuration& noteDuration, int noteNumber, int velocity, const juce::String& lyric)
 {
-    // Static variable to generate unique IDs
-    static int nextId = 1;
+    return Note(document.getNoteIdAllocator().allocate(), startTime, noteDuration, noteNumber, velocity, lyric);
 }
 
-SongDocument::Note SongDocument::DataFactory::makeNote(const cctn::song::SongDocument& document, const MusicalTime& startTime, const NoteDuration& noteDuration, int noteNumber, int velocity, const juce::String& lyric)
+SongDocument::Note SongDocument::DataFactory::makeNote(int noteId, const MusicalTime& startTime, const NoteDuration& noteDuration, int noteNumber, int velocity, const juce::String& lyric)
 {
-    return Note(nextId++, startTime, noteDuration, noteNumber, velocity, lyric);
+    return Note(noteId, startTime, noteDuration, noteNumber, velocity, lyric);
 }
 
 SongDocument::NoteDuration SongDocument::DataFactory::convertNoteLengthToDuration(const SongDocument& document, NoteLength noteLength)
 {
-    int ticksPerQuarterNote = document.getTicksPerQuarterNote();
-    double quarterNotes = 1.0 / getNoteLengthsPerQuarterNote(noteLength);
-    int totalTicks = std::round(quarterNotes * ticksPerQuarterNote);
+    const int totalTicks = (int)getTicksPerNoteLength(noteLength, document.getTicksPerQuarterNote());
 
     return NoteDuration{ totalTicks };
 }
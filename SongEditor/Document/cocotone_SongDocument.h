@@ -12,6 +12,12 @@ public:
     //==============================================================================
     // Forward declaration
     class DataFactory;
+    class BeatTimePointsFactory;
+    class NoteView;
+    class NoteStore;
+
+    //==============================================================================
+    static constexpr int kDefaultTicksPerQuarterNote = 480;
 
     //==============================================================================
     // Internal Data Types
@@ -99,8 +105,8 @@ public:
     {
     private:
         // Private constructor
-        Note(int id, MusicalTime startTime, NoteDuration dur, int noteNum, int vel, const juce::String& lyr)
-            : id(id)
+        Note(int noteId, MusicalTime startTime, NoteDuration dur, int noteNum, int vel, const juce::String& lyr)
+            : id(noteId)
             , startTimeInMusicalTime(startTime)
             , duration(dur)
             , noteNumber(noteNum)
@@ -118,10 +124,172 @@ public:
 
         // Make DataFactory a friend so it can access the private constructor
         friend class DataFactory;
+        friend class NoteView;
+        friend class NoteStore;
 
         JUCE_LEAK_DETECTOR(Note)
     };
 
+    //==============================================================================
+    // Absolute position of a note which is derived from the tempo track.
+    struct NoteTiming
+    {
+        int64_t noteOnTick{ 0 };
+        int64_t noteOffTick{ 0 };
+        double noteOnTimeInSeconds{ 0.0 };
+        double noteOffTimeInSeconds{ 0.0 };
+    };
+
+    //==============================================================================
+    // Read access to one note in NoteStore. Valid until the next edit of the document.
+    class NoteView
+    {
+    public:
+        //==============================================================================
+        int getId() const;
+        MusicalTime getStartTime() const;
+        NoteDuration getDuration() const;
+        int getNoteNumber() const;
+        int getVelocity() const;
+        const juce::String& getLyric() const;
+        int getLyricId() const;
+        NoteTiming getTiming() const;
+
+        // Copy as Note, e.g. to edit and pass to SongDocument::updateNotes.
+        Note toNote() const;
+
+    private:
+        //==============================================================================
+        NoteView(const NoteStore& ownerStore, int slotIndex) : store(&ownerStore), slot(slotIndex) {}
+
+        const NoteStore* store;
+        int slot;
+
+        friend class NoteStore;
+    };
+
+    //==============================================================================
+    // Notes as one column per field, so a scan over one field stays in cache and vectorises.
+    // Removal moves the last note into the freed slot, so refer to notes by id, not by slot.
+    // Timing columns are derived from the tempo track and kept by SongDocument.
+    class NoteStore
+    {
+    public:
+        //==============================================================================
+        // Same as MusicalTime, without leak detector.
+        struct StartPosition
+        {
+            int bar;
+            int beat;
+            int tick;
+        };
+
+        //==============================================================================
+        int size() const { return (int)ids.size(); }
+        bool isEmpty() const { return ids.empty(); }
+
+        NoteView operator[](int slot) const { jassert(0 <= slot && slot < size()); return NoteView(*this, slot); }
+        // Constant time, independent of slot order.
+        std::optional<int> findSlot(int noteId) const;
+        bool contains(int noteId) const { return slotsById.count(noteId) > 0; }
+
+        // Slot order changes on removal. Ordered by note on tick then id, e.g. for saving.
+        std::vector<int> getSlotsInStartOrder() const;
+
+        //==============================================================================
+        class Iterator
+        {
+        public:
+            NoteView operator*() const { return (*store)[slot]; }
+            Iterator& operator++() { ++slot; return *this; }
+            bool operator!=(const Iterator& other) const { return slot != other.slot; }
+
+        private:
+            Iterator(const NoteStore& ownerStore, int slotIndex) : store(&ownerStore), slot(slotIndex) {}
+
+            const NoteStore* store;
+            int slot;
+
+            friend class NoteStore;
+        };
+        Iterator begin() const { return Iterator(*this, 0); }
+        Iterator end() const { return Iterator(*this, size()); }
+
+        //==============================================================================
+        // Columns, indexed by slot.
+        const std::vector<int>& getIds() const { return ids; }
+        const std::vector<StartPosition>& getStartPositions() const { return startPositions; }
+        const std::vector<int>& getDurationsInTicks() const { return durationsInTicks; }
+        const std::vector<int>& getNoteNumbers() const { return noteNumbers; }
+        const std::vector<int>& getVelocities() const { return velocities; }
+        const std::vector<int>& getLyricIds() const { return lyricIds; }
+        const std::vector<int64_t>& getNoteOnTicks() const { return noteOnTicks; }
+        const std::vector<int64_t>& getNoteOffTicks() const { return noteOffTicks; }
+        const std::vector<double>& getNoteOnTimesInSeconds() const { return noteOnTimesInSeconds; }
+        const std::vector<double>& getNoteOffTimesInSeconds() const { return noteOffTimesInSeconds; }
+
+        const LyricTable& getLyricTable() const { return lyrics; }
+        const juce::String& getLyricText(int lyricId) const { return lyrics.getText(lyricId); }
+
+    private:
+        //==============================================================================
+        int add(const Note& note, const NoteTiming& timing);
+        void set(int slot, const Note& note, const NoteTiming& timing);
+        void setTiming(int slot, const NoteTiming& timing);
+        void remove(int slot);
+
+        NoteTiming getTiming(int slot) const;
+
+        //==============================================================================
+        std::vector<int> ids;
+        std::vector<StartPosition> startPositions;
+        std::vector<int> durationsInTicks;
+        std::vector<int> noteNumbers;
+        std::vector<int> velocities;
+        std::vector<int> lyricIds;
+
+        std::vector<int64_t> noteOnTicks;
+        std::vector<int64_t> noteOffTicks;
+        std::vector<double> noteOnTimesInSeconds;
+        std::vector<double> noteOffTimesInSeconds;
+
+        // Key is Note::id.
+        std::unordered_map<int, int> slotsById;
+
+        // Lyric column holds ids into this table, each stored note keeps its lyric alive.
+        LyricTable lyrics;
+
+        friend class NoteView;
+        friend class SongDocument;
+    };
+
+    //==============================================================================
+    // Hands out note ids which are unique within one document. Lock free, so worker threads
+    // can mint ids one by one or take a block of them up front.
+    class NoteIdAllocator
+    {
+    public:
+        //==============================================================================
+        NoteIdAllocator() = default;
+        NoteIdAllocator(const NoteIdAllocator& other) : nextId(other.getNextId()) {}
+        NoteIdAllocator& operator=(const NoteIdAllocator& other) { nextId.store(other.getNextId(), std::memory_order_relaxed); return *this; }
+
+        //==============================================================================
+        int allocate() { return nextId.fetch_add(1, std::memory_order_relaxed); }
+
+        // Consecutive ids, e.g. one block per import job.
+        juce::Range<int> allocateBlock(int numIds);
+
+        // Keeps ids from now on above the given one. Used for notes with saved ids.
+        void reserveUpTo(int noteId);
+
+        int getNextId() const { return nextId.load(std::memory_order_relaxed); }
+
+    private:
+        //==============================================================================
+        std::atomic<int> nextId{ 1 };
+    };
+
     //==============================================================================
     class TempoEvent
     {
@@ -133,23 +301,44 @@ public:
             kBoth
         };
 
-        TempoEvent(int64_t tick, TempoEventType type, int numerator = 4, int denominator = 4, double tempo = 120)
+        // How tempo changes from this event to the next tempo event.
+        enum class TempoCurve
+        {
+            kStep,
+            kLinear,
+            kExponential
+        };
+
+        TempoEvent(int64_t tick, TempoEventType type, int numerator = 4, int denominator = 4, double tempo = 120, TempoCurve tempoCurve = TempoCurve::kStep)
             : tick(tick)
             , type(type)
             , timeSignature({ numerator, denominator })
             , tempo(tempo)
+            , curve(tempoCurve)
         {}
 
         int64_t getTick() const { return tick; }
         TempoEventType getEventType() const { return type; }
         double getTempo() const { return tempo; }
         TimeSignature getTimeSignature() const { return timeSignature; }
+        TempoCurve getTempoCurve() const { return curve; }
+
+        bool hasTempo() const { return type == TempoEventType::kTempo || type == TempoEventType::kBoth; }
+        bool hasTimeSignature() const { return type == TempoEventType::kTimeSignature || type == TempoEventType::kBoth; }
+
+        TempoEvent withTick(int64_t newTick) const
+        {
+            TempoEvent result(*this);
+            result.tick = newTick;
+            return result;
+        }
 
     private:
         int64_t tick;
         TempoEventType type;
         TimeSignature timeSignature;
         double tempo;
+        TempoCurve curve;
 
         JUCE_LEAK_DETECTOR(TempoEvent)
     };
@@ -158,17 +347,62 @@ public:
     class TempoTrack
     {
     public:
-        void addEvent(const TempoEvent& event) 
+        // Insert event with keeping order by tick. Returns index of the inserted event.
+        size_t addEvent(const TempoEvent& event) 
         {
-            events.push_back(event);
-            std::sort(events.begin(), events.end(),
-                [](const TempoEvent& a, const TempoEvent& b) 
+            auto it = std::upper_bound(events.begin(), events.end(), event.getTick(),
+                [](int64_t tick, const TempoEvent& e)
                 {
-                    return a.getTick() < b.getTick(); 
+                    return tick < e.getTick();
                 });
+
+            return (size_t)std::distance(events.begin(), events.insert(it, event));
+        }
+
+        // Replace all events at once. Events are expected to be sorted by tick.
+        void loadEvents(std::vector<TempoEvent> sortedEvents)
+        {
+            const auto compare_tick = [](const TempoEvent& a, const TempoEvent& b)
+                {
+                    return a.getTick() < b.getTick();
+                };
+
+            if (!std::is_sorted(sortedEvents.begin(), sortedEvents.end(), compare_tick))
+            {
+                jassertfalse;
+                std::stable_sort(sortedEvents.begin(), sortedEvents.end(), compare_tick);
+            }
+
+            events = std::move(sortedEvents);
+        }
+
+        void removeEvent(size_t index)
+        {
+            jassert(index < events.size());
+            events.erase(events.begin() + index);
+        }
+
+        // Returns new index of the replaced event.
+        size_t replaceEvent(size_t index, const TempoEvent& event)
+        {
+            jassert(index < events.size());
+
+            if (events[index].getTick() == event.getTick())
+            {
+                events[index] = event;
+                return index;
+            }
+
+            removeEvent(index);
+            return addEvent(event);
         }
 
-        // Other methods for querying and managing tempo events
+        // Returns new index of the moved event.
+        size_t moveEvent(size_t index, int64_t newTick)
+        {
+            jassert(index < events.size());
+            return replaceEvent(index, events[index].withTick(newTick));
+        }
 
         const std::vector<TempoEvent>& getEvents() const { return events; };
 
@@ -178,6 +412,84 @@ public:
         JUCE_LEAK_DETECTOR(TempoTrack)
     };
 
+    //==============================================================================
+    // TempoMap is precomputed index of TempoTrack.
+    // Each segment holds cumulative ticks, seconds and bar number at the tempo event.
+    class TempoMap
+    {
+    public:
+        struct Segment
+        {
+            int64_t startTick{ 0 };
+            double startTimeInSeconds{ 0.0 };
+            int startBar{ 1 };
+
+            // Position where current time signature takes effect.
+            int64_t barOriginTick{ 0 };
+            int barOriginBar{ 1 };
+
+            int numerator{ 4 };
+            int denominator{ 4 };
+            double tempo{ 120.0 };
+
+            int64_t ticksPerBar{ 0 };
+            int64_t ticksPerBeat{ 0 };
+
+            // Values at the start of the segment.
+            double secondsPerTick{ 0.0 };
+            double ticksPerSecond{ 0.0 };
+
+            // Tempo as integer for exact sample position arithmetic.
+            int64_t tempoInMilliBpm{ 120000 };
+
+            // Tempo ramp toward the next tempo event.
+            TempoEvent::TempoCurve curve{ TempoEvent::TempoCurve::kStep };
+            double endTempo{ 120.0 };
+            int64_t rampEndTick{ 0 };
+            double rampRate{ 0.0 };
+
+            // Curve is kept even without next tempo event, so that the ramp is resolved when it is added.
+            bool isRamp() const { return curve != TempoEvent::TempoCurve::kStep && rampRate != 0.0; }
+
+            // Closed form integral of the tempo curve and its inverse.
+            double getTempoAt(double ticksFromStart) const;
+            double ticksToSecondsFromStart(double ticksFromStart) const;
+            double secondsToTicksFromStart(double secondsFromStart) const;
+        };
+
+        void rebuild(const TempoTrack& tempoTrack, int newTicksPerQuarterNote);
+
+        // Keep segments before the given tick and rebuild the rest.
+        // Returns the tick from which segments are actually rebuilt.
+        int64_t rebuildFrom(const TempoTrack& tempoTrack, int newTicksPerQuarterNote, int64_t firstAffectedTick);
+
+        const std::vector<Segment>& getSegments() const { return segments; }
+        int getTicksPerQuarterNote() const { return ticksPerQuarterNote; }
+
+        // Time conversions which only depend on the tempo map.
+        double tickToAbsoluteTime(int64_t targetTick) const;
+        int64_t absoluteTimeToTick(double targetTime) const;
+        int64_t tickToSamples(int64_t targetTick, double sampleRate) const;
+        int64_t samplesToTick(int64_t targetSamples, double sampleRate) const;
+
+        // Find the last segment which starts at or before the given position.
+        const Segment& findSegmentByTick(int64_t tick) const;
+        const Segment& findSegmentByTime(double timeInSeconds) const;
+        const Segment& findSegmentByBar(int bar) const;
+        size_t findSegmentIndexByTick(int64_t tick) const;
+        size_t findSegmentIndexByTime(double timeInSeconds) const;
+
+    private:
+        // Samples from the start of the segment, floored. Segment start samples are the sums of
+        // the preceding segment lengths, so positions never jump at a segment boundary.
+        int64_t ticksToSamplesFromStart(const Segment& segment, int64_t ticksFromStart, int64_t sampleRate) const;
+
+        std::vector<Segment> segments;
+        int ticksPerQuarterNote{ 0 };
+
+        JUCE_LEAK_DETECTOR(TempoMap)
+    };
+
     //==============================================================================
     struct BeatTimePoint
     {
@@ -211,6 +523,15 @@ public:
         JUCE_LEAK_DETECTOR(RegionWithBeatInfo)
     };
 
+    //==============================================================================
+    // Notified after every tempo or time signature edit, on the thread which made the edit.
+    class TempoMapListener
+    {
+    public:
+        virtual ~TempoMapListener() = default;
+        virtual void tempoMapChanged(const SongDocument& document) = 0;
+    };
+
     //==============================================================================
     // SongDocument
     //==============================================================================
@@ -221,11 +542,24 @@ public:
     void setMetadata(const juce::String& title, const juce::String& artist);
     
     //==============================================================================
-    void addTempoEvent(int64_t tick, TempoEvent::TempoEventType type, int numerator = 4, int denominator = 4, double tempo = 120.0);
+    void addTempoEvent(int64_t tick, TempoEvent::TempoEventType type, int numerator = 4, int denominator = 4, double tempo = 120.0, TempoEvent::TempoCurve curve = TempoEvent::TempoCurve::kStep);
+    void loadTempoEvents(const std::vector<TempoEvent>& sortedEvents);
+    void removeTempoEvent(size_t index);
+    void replaceTempoEvent(size_t index, const TempoEvent& event);
+    void moveTempoEvent(size_t index, int64_t newTick);
+
+    // Listeners belong to this instance, a copy of the document starts without any.
+    void addTempoMapListener(TempoMapListener* listener) { tempoMapListeners.listeners.add(listener); }
+    void removeTempoMapListener(TempoMapListener* listener) { tempoMapListeners.listeners.remove(listener); }
 
     //==============================================================================
+    // Notes with an id which is already in this document, or a note number outside MIDI range, are rejected.
     void addNote(const Note& note);
-    void removeNote(const Note* note);
+    void removeNote(int noteId);
+
+    // Replaces notes of the same id as a single change. Notes which are not in this document are skipped,
+    // notes out of MIDI range are rejected as in addNote.
+    void updateNotes(const juce::Array<Note>& updatedNotes);
 
     //==============================================================================
     // Getters
@@ -235,11 +569,42 @@ public:
     juce::Time getLastModifiedTime() const { return metadata.lastModified; }
     int getTicksPerQuarterNote() const { return ticksPerQuarterNote; }
     const TempoTrack& getTempoTrack() const { return tempoTrack; }
-    const juce::Array<Note>& getNotes() const { return notes; }
+    const TempoMap& getTempoMap() const { return tempoMap; }
+    const NoteStore& getNotes() const { return notes; }
+    const LyricTable& getLyricTable() const { return notes.getLyricTable(); }
+
+    // Minting ids is lock free, blocks may be handed to jobs off the message thread.
+    NoteIdAllocator& getNoteIdAllocator() { return noteIdAllocator; }
+    const NoteIdAllocator& getNoteIdAllocator() const { return noteIdAllocator; }
+
+    // Changes on every edit. Unique across documents, copies share it until edited.
+    uint64_t getRevision() const { return revision; }
+
+    // First tick where tempo map or song end changed since the given revision of this document.
+    // Grids and quantize regions before it are still valid. Returns max of int64_t when nothing changed,
+    // and nullopt when the revision is unknown or too old.
+    std::optional<int64_t> findFirstChangedTickSince(uint64_t sinceRevision) const;
+
+    //==============================================================================
+    // Get cached absolute position of the note
+    NoteTiming getNoteTiming(const Note& note) const;
+    NoteTiming getNoteTiming(const NoteView& note) const { return note.getTiming(); }
+
+    // Constant time lookup by Note::id.
+    std::optional<NoteView> findNoteById(int noteId) const;
+
+    // Notes which overlap the half-open tick range, or contain the tick, in start tick order.
+    // Found via interval index without scanning every note. Views are valid until the next edit.
+    std::vector<NoteView> findNotesInRange(juce::Range<int64_t> rangeInTicks) const;
+    std::vector<NoteView> findNotesAtTick(int64_t tick) const;
+
+    // Same, limited to the half-open note number range or one note number. For piano roll hit tests.
+    std::vector<NoteView> findNotesInArea(juce::Range<int64_t> rangeInTicks, juce::Range<int> noteNumbers) const;
+    std::vector<NoteView> findNotesAt(int64_t tick, int noteNumber) const;
 
     //==============================================================================
     // Get the total length of the song in ticks
-    int64_t getTotalLengthInTicks() const;
+    int64_t getTotalLengthInTicks() const { return totalLengthInTicks; }
 
     //==============================================================================
     std::string dumpToString() const;
@@ -247,6 +612,10 @@ public:
     //==============================================================================
     juce::var toJson() const;
 
+    // Reads what toJson writes. Returns nullptr when a required field is missing or the resolution is not the default.
+    // Notes keep their saved ids, new ids are minted after nextNoteId and after every loaded id.
+    static std::unique_ptr<SongDocument> fromJson(const juce::var& json);
+
     //==============================================================================
     class Calculator
     {
@@ -257,10 +626,24 @@ public:
         static MusicalTime tickToBar(const cctn::song::SongDocument& document, int64_t targetTick);
         static double tickToAbsoluteTime(const cctn::song::SongDocument& document, int64_t targetTick);
         static int64_t absoluteTimeToTick(const cctn::song::SongDocument& document, double targetTime);
+
+        //==============================================================================
+        // Batch conversion over ascending sorted values. Walks the tempo map once.
+        static void ticksToAbsoluteTimes(const cctn::song::SongDocument& document, const int64_t* sortedTicks, double* destTimesInSeconds, int numValues);
+        static void absoluteTimesToTicks(const cctn::song::SongDocument& document, const double* sortedTimesInSeconds, int64_t* destTicks, int numValues);
+
+        //==============================================================================
+        // Convert tick to sample position at the given sample rate.
+        // Step segments use exact integer ratio, so the same input always gives the same sample.
+        static int64_t tickToSamples(const cctn::song::SongDocument& document, int64_t targetTick, double sampleRate);
+        static int64_t samplesToTick(const cctn::song::SongDocument& document, int64_t targetSamples, double sampleRate);
+
+        //==============================================================================
         static int64_t noteLengthToTicks(const cctn::song::SongDocument& document, const NoteLength resolution);
 
         //==============================================================================
         static MusicalTime calculateNoteOffPosition(const SongDocument& document, const Note& note);
+        static NoteTiming calculateNoteTiming(const SongDocument& document, const Note& note);
         
     private:
         //==============================================================================
@@ -270,14 +653,82 @@ public:
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Calculator)
     };
 
+    //==============================================================================
+    // Walks grid points one by one without allocating. The grid never ends, so stop at the edge of view.
+    // Must not outlive the tempo map or be used after it is rebuilt.
+    class BeatTimePointIterator
+    {
+    public:
+        //==============================================================================
+        const BeatTimePoint& operator*() const { return current; }
+        const BeatTimePoint* operator->() const { return &current; }
+        BeatTimePointIterator& operator++();
+
+    private:
+        //==============================================================================
+        BeatTimePointIterator(const TempoMap& tempoMap, int64_t newTicksPerStep, int64_t startTick);
+
+        void enterSegment(size_t index, int64_t fromTick);
+        void settle();
+
+        const std::vector<TempoMap::Segment>* segments;
+        int64_t ticksPerStep;
+        size_t segmentIndex{ 0 };
+        int64_t segmentEndTick{ 0 };
+        int64_t barIndex{ 0 };
+        int64_t barStartTick{ 0 };
+        int64_t ticksInBar{ 0 };
+        BeatTimePoint current{ 0, { 1, 1, 0 }, 0.0 };
+
+        friend class BeatTimePointsFactory;
+    };
+
     //==============================================================================
     class BeatTimePointsFactory
     {
     public:
         //==============================================================================
+        // Lazy grid from the first point at or after the given position, found via tempo map.
+        // TempoMap overloads work on a copy or a published snapshot as well.
+        static BeatTimePointIterator makeBeatTimePointIterator(const cctn::song::SongDocument& document, NoteLength resolution, int64_t startTick);
+        static BeatTimePointIterator makeBeatTimePointIteratorAtTime(const cctn::song::SongDocument& document, NoteLength resolution, double startTimeInSeconds);
+        static BeatTimePointIterator makeBeatTimePointIterator(const TempoMap& tempoMap, NoteLength resolution, int64_t startTick);
+        static BeatTimePointIterator makeBeatTimePointIteratorAtTime(const TempoMap& tempoMap, NoteLength resolution, double startTimeInSeconds);
+
+        //==============================================================================
+        // Grid of whole song. Last point is at or after the end of song.
         static BeatTimePoints makeBeatTimePoints(const cctn::song::SongDocument& document, NoteLength resolution);
 
+        // Same as makeBeatTimePoints, but copies points before firstChangedTick from a grid of an earlier revision.
+        // See SongDocument::findFirstChangedTickSince.
+        static BeatTimePoints patchBeatTimePoints(const cctn::song::SongDocument& document, NoteLength resolution, const BeatTimePoints& previousPoints, int64_t firstChangedTick);
+
+        // Grid points only in the given window. Tick range is half-open, time range includes both ends.
+        static BeatTimePoints makeBeatTimePointsInRange(const cctn::song::SongDocument& document, NoteLength resolution, juce::Range<int64_t> rangeInTicks);
+        static BeatTimePoints makeBeatTimePointsInTimeRange(const cctn::song::SongDocument& document, NoteLength resolution, juce::Range<double> rangeInSeconds);
+
+        //==============================================================================
+        // Grid generation specialised for note length and resolution.
+        // Select once when grid size changes and call with the step of the same note length.
+        // Grid restarts at every bar line, so any window is generated without walking from the song start.
+        using GridKernel = void (*)(const cctn::song::SongDocument& document, int64_t ticksPerStep, juce::Range<int64_t> rangeInTicks, size_t maxNumPoints, BeatTimePoints& dest);
+        static GridKernel getGridKernel(NoteLength resolution, int ticksPerQuarterNote);
+
     private:
+        //==============================================================================
+        static int64_t getEndOfGridInTicks(const cctn::song::SongDocument& document);
+        static void appendBeatTimePointsToEnd(const cctn::song::SongDocument& document, NoteLength resolution, int64_t startTick, BeatTimePoints& dest);
+
+        // Loop body is instantiated per step, so the step and its divisions are compile time constants.
+        // kVariableStep reads the step from the argument instead, for other resolutions.
+        static constexpr int64_t kVariableStep = 0;
+
+        template <int64_t FixedTicksPerStep>
+        static void appendBeatTimePoints(const cctn::song::SongDocument& document, int64_t ticksPerStep, juce::Range<int64_t> rangeInTicks, size_t maxNumPoints, BeatTimePoints& dest);
+
+        template <int TicksPerQuarterNote, size_t... NoteLengthIndices>
+        static constexpr std::array<GridKernel, kNumNoteLengths> makeGridKernelTable(std::index_sequence<NoteLengthIndices...>);
+
         //==============================================================================
         BeatTimePointsFactory() = delete;
         ~BeatTimePointsFactory() = delete;
@@ -290,7 +741,11 @@ public:
     {
     public:
         //==============================================================================
-        static Note makeNote(const cctn::song::SongDocument& document, const MusicalTime& startTime, const NoteDuration& noteDuration, int noteNumber, int velocity, const juce::String& lyric);
+        // Takes the next id from the document's allocator.
+        static Note makeNote(cctn::song::SongDocument& document, const MusicalTime& startTime, const NoteDuration& noteDuration, int noteNumber, int velocity, const juce::String& lyric);
+
+        // With an id which is already allocated, e.g. from a block or a saved document.
+        static Note makeNote(int noteId, const MusicalTime& startTime, const NoteDuration& noteDuration, int noteNumber, int velocity, const juce::String& lyric);
 
         //=========================================================================
         static NoteDuration convertNoteLengthToDuration(const SongDocument& document, NoteLength noteLength);
@@ -332,10 +787,48 @@ private:
     //==============================================================================
     Metadata metadata;
     int ticksPerQuarterNote;
+    const int minimumTotalLengthInTicks;
     TempoTrack tempoTrack;
-    juce::Array<Note> notes;
+    TempoMap tempoMap;
 
-    const int minimumTotalLengthInTicks;
+    struct TempoMapListeners
+    {
+        TempoMapListeners() = default;
+        TempoMapListeners(const TempoMapListeners&) {}
+        TempoMapListeners& operator=(const TempoMapListeners&) { return *this; }
+
+        juce::ListenerList<TempoMapListener> listeners;
+    };
+    TempoMapListeners tempoMapListeners;
+
+    // Timing columns are rebuilt when the tempo track changes.
+    NoteStore notes;
+    NoteIdAllocator noteIdAllocator;
+
+    // Tick ranges of all notes, kept in sync with timing columns.
+    NoteIntervalIndex noteIntervalIndex;
+
+    // Note off ticks of all notes, to track the song end on add/remove.
+    std::multiset<int64_t> noteOffTicks;
+    int64_t totalLengthInTicks;
+
+    uint64_t revision{ 0 };
+
+    // Recent edits, oldest first.
+    struct RevisionChange
+    {
+        uint64_t previousRevision;
+        int64_t firstChangedTick;
+    };
+    static constexpr size_t kMaxNumRevisionChanges = 64;
+    std::vector<RevisionChange> revisionChanges;
+
+    static bool isValidNoteNumber(int noteNumber) { return 0 <= noteNumber && noteNumber < NoteIntervalIndex::kNumNoteNumbers; }
+
+    int64_t updateTotalLengthInTicks();
+    void updateTempoDerivedData(int64_t firstAffectedTick);
+    void updateRevision(int64_t firstChangedTick);
+    std::vector<NoteView> findNotesById(const std::vector<int>& noteIds) const;
 
     JUCE_LEAK_DETECTOR(SongDocument)
 };
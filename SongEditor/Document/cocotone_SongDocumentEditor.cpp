@@ -3,23 +3,147 @@ namespace cctn
 namespace song
 {
 
+//==============================================================================
+namespace
+{
+    struct QuantizedNoteSpan
+    {
+        int64_t noteOnTick;
+        int64_t noteOffTick;
+        int64_t originalNoteOnTick;
+        int64_t originalNoteOffTick;
+        bool isMovable;
+    };
+
+    // Vocal line is monophonic. A movable note which runs into the next note is trimmed to its start.
+    // One which would start inside or together with a note it can't trim goes back to its original span.
+    // Overlaps between notes which don't move are left as they are.
+    void resolveQuantizedOverlaps(std::vector<QuantizedNoteSpan>& spans)
+    {
+        std::vector<size_t> order(spans.size());
+        std::vector<int64_t> resolved_note_off_ticks(spans.size());
+        std::vector<size_t> indices_to_restore;
+
+        for (;;)
+        {
+            std::iota(order.begin(), order.end(), (size_t)0);
+            std::sort(order.begin(), order.end(), [&spans](size_t lhs, size_t rhs)
+                {
+                    // Fixed notes first on the same tick, so the movable one gives way.
+                    return std::make_tuple(spans[lhs].noteOnTick, spans[lhs].isMovable, lhs) < std::make_tuple(spans[rhs].noteOnTick, spans[rhs].isMovable, rhs);
+                });
+
+            for (size_t i = 0; i < spans.size(); ++i)
+            {
+                resolved_note_off_ticks[i] = spans[i].noteOffTick;
+            }
+
+            auto fixed_note_off_tick = std::numeric_limits<int64_t>::min();
+            std::optional<size_t> last_movable_index;
+            indices_to_restore.clear();
+
+            for (const auto index : order)
+            {
+                const auto& span = spans[index];
+
+                if (last_movable_index.has_value() && resolved_note_off_ticks[last_movable_index.value()] > span.noteOnTick)
+                {
+                    if (spans[last_movable_index.value()].noteOnTick < span.noteOnTick)
+                    {
+                        resolved_note_off_ticks[last_movable_index.value()] = span.noteOnTick;
+                    }
+                    else if (span.isMovable)
+                    {
+                        indices_to_restore.push_back(index);
+                        continue;
+                    }
+                    else
+                    {
+                        indices_to_restore.push_back(last_movable_index.value());
+                        last_movable_index.reset();
+                    }
+                }
+
+                if (!span.isMovable)
+                {
+                    fixed_note_off_tick = std::max(fixed_note_off_tick, span.noteOffTick);
+                }
+                else if (fixed_note_off_tick > span.noteOnTick)
+                {
+                    indices_to_restore.push_back(index);
+                }
+                else
+                {
+                    last_movable_index = index;
+                }
+            }
+
+            if (indices_to_restore.empty())
+            {
+                break;
+            }
+
+            // Restored notes are fixed from now on. Each round fixes at least one more note, so this ends.
+            for (const auto index : indices_to_restore)
+            {
+                auto& restored_span = spans[index];
+                restored_span.noteOnTick = restored_span.originalNoteOnTick;
+                restored_span.noteOffTick = restored_span.originalNoteOffTick;
+                restored_span.isMovable = false;
+            }
+        }
+
+        for (size_t i = 0; i < spans.size(); ++i)
+        {
+            spans[i].noteOffTick = resolved_note_off_ticks[i];
+        }
+    }
+}
+
 //==============================================================================
 SongDocumentEditor::SongDocumentEditor()
 {
     editorContext = std::make_unique<cctn::song::SongDocumentEditor::EditorContext>();
 
     quantizeEngine = std::make_unique<cctn::song::QuantizeEngine>();
+
+    tempoMapPublisher = std::make_unique<cctn::song::TempoMapPublisher>();
+
+    beatTimePointsCache = std::make_unique<cctn::song::BeatTimePointsCache>();
 }
 
 SongDocumentEditor::~SongDocumentEditor()
 {
+    if (documentToEdit.get() != nullptr)
+    {
+        documentToEdit->removeTempoMapListener(this);
+    }
 }
 
 //==============================================================================
 void SongDocumentEditor::attachDocument(std::shared_ptr<cctn::song::SongDocument> document)
 {
+    if (documentToEdit.get() != nullptr)
+    {
+        documentToEdit->removeTempoMapListener(this);
+    }
+
     documentToEdit = document;
 
+    // Published once here, later tempo edits reach realtime readers through tempoMapChanged.
+    if (documentToEdit.get() != nullptr)
+    {
+        documentToEdit->addTempoMapListener(this);
+        tempoMapPublisher->publish(*documentToEdit.get());
+    }
+    else
+    {
+        tempoMapPublisher->clear();
+    }
+
+    // Ticks per step depend on resolution of the document.
+    grooveTableGridSize.reset();
+
     updateEditorContext();
 
     sendChangeMessage();
@@ -27,7 +151,13 @@ void SongDocumentEditor::attachDocument(std::shared_ptr<cctn::song::SongDocument
 
 void SongDocumentEditor::detachDocument()
 {
+    if (documentToEdit.get() != nullptr)
+    {
+        documentToEdit->removeTempoMapListener(this);
+    }
+
     documentToEdit.reset();
+    tempoMapPublisher->clear();
 
     updateEditorContext();
 
@@ -62,18 +192,13 @@ std::optional<cctn::song::SongDocument::Note> SongDocumentEditor::findNote(const
         return std::nullopt;
     }
 
-    for (auto& note : (*documentToEdit).getNotes())
+    for (const auto& note : findNoteCandidatesAt(query.timeInSeconds, query.noteNumber))
     {
-        const auto note_on_tick = cctn::song::SongDocument::Calculator::barToTick((*documentToEdit), note.startTimeInMusicalTime);
-        const auto note_on_position_in_seconds = cctn::song::SongDocument::Calculator::tickToAbsoluteTime((*documentToEdit), note_on_tick);
+        const auto note_timing = note.getTiming();
 
-        const auto note_off_bar = cctn::song::SongDocument::Calculator::calculateNoteOffPosition((*documentToEdit), note);
-        const auto note_off_tick = cctn::song::SongDocument::Calculator::barToTick((*documentToEdit), note_off_bar);
-        const auto note_off_position_in_seconds = cctn::song::SongDocument::Calculator::tickToAbsoluteTime((*documentToEdit), note_off_tick);
-
-        if (juce::Range<double>(note_on_position_in_seconds, note_off_position_in_seconds).contains(query.timeInSeconds))
+        if (juce::Range<double>(note_timing.noteOnTimeInSeconds, note_timing.noteOffTimeInSeconds).contains(query.timeInSeconds))
         {
-            return note;
+            return note.toNote();
         }
     }
 
@@ -87,24 +212,17 @@ void SongDocumentEditor::selectNote(const cctn::song::QueryForFindPianoRollNote&
         return;
     }
 
-    for (auto& note : (*documentToEdit).getNotes())
-    {
-        const auto note_on_tick = cctn::song::SongDocument::Calculator::barToTick((*documentToEdit), note.startTimeInMusicalTime);
-        const auto note_on_position_in_seconds = cctn::song::SongDocument::Calculator::tickToAbsoluteTime((*documentToEdit), note_on_tick);
+    editorContext->currentSelectedNoteId = -1;
 
-        const auto note_off_bar = cctn::song::SongDocument::Calculator::calculateNoteOffPosition((*documentToEdit), note);
-        const auto note_off_tick = cctn::song::SongDocument::Calculator::barToTick((*documentToEdit), note_off_bar);
-        const auto note_off_position_in_seconds = cctn::song::SongDocument::Calculator::tickToAbsoluteTime((*documentToEdit), note_off_tick);
+    for (const auto& note : findNoteCandidatesAt(query.timeInSeconds, query.noteNumber))
+    {
+        const auto note_timing = note.getTiming();
 
-        if (juce::Range<double>(note_on_position_in_seconds, note_off_position_in_seconds).contains(query.timeInSeconds))
+        if (juce::Range<double>(note_timing.noteOnTimeInSeconds, note_timing.noteOffTimeInSeconds).contains(query.timeInSeconds))
         {
-            editorContext->currentSelectedNoteId = note.id;
+            editorContext->currentSelectedNoteId = note.getId();
             break;
         }
-        else
-        {
-            editorContext->currentSelectedNoteId = -1;
-        }
     }
 
     sendChangeMessage();
@@ -119,10 +237,10 @@ void SongDocumentEditor::createNote(const cctn::song::QueryForAddPianoRollNote&
 
     if (query.snapToQuantizeGrid)
     {
-        const auto quantize_region_optional = quantizeEngine->findNearestQuantizeRegion(query.startTimeInSeconds);
-        if (quantize_region_optional.has_value())
+        const auto quantize_region_index = findQuantizeRegionIndexForInput(query.startTimeInSeconds);
+        if (quantize_region_index.has_value())
         {
-            const auto& start_time = quantize_region_optional.value().startMusicalTime;
+            const auto start_time = quantizeEngine->getRegionStartMusicalTime(quantize_region_index.value());
 
             const auto note_duration = 
                 cctn::song::SongDocument::DataFactory::convertNoteLengthToDuration(*documentToEdit.get(), editorContext->currentNoteLength);
@@ -151,48 +269,346 @@ void SongDocumentEditor::deleteNoteSingle(const cctn::song::QueryForFindPianoRol
         return;
     }
 
-    const cctn::song::SongDocument::Note* note_to_delete = nullptr;
+    std::optional<int> note_id_to_delete;
 
-    for (const auto& note : (*documentToEdit).getNotes())
+    for (const auto& note : findNoteCandidatesAt(query.timeInSeconds, query.noteNumber))
     {
-        const auto note_on_tick = cctn::song::SongDocument::Calculator::barToTick((*documentToEdit), note.startTimeInMusicalTime);
-        const auto note_on_position_in_seconds = cctn::song::SongDocument::Calculator::tickToAbsoluteTime((*documentToEdit), note_on_tick);
+        const auto note_timing = note.getTiming();
 
-        const auto note_off_bar = cctn::song::SongDocument::Calculator::calculateNoteOffPosition((*documentToEdit), note);
-        const auto note_off_tick = cctn::song::SongDocument::Calculator::barToTick((*documentToEdit), note_off_bar);
-        const auto note_off_position_in_seconds = cctn::song::SongDocument::Calculator::tickToAbsoluteTime((*documentToEdit), note_off_tick);
+        if (juce::Range<double>(note_timing.noteOnTimeInSeconds, note_timing.noteOffTimeInSeconds).contains(query.timeInSeconds))
+        {
+            note_id_to_delete = note.getId();
+        }
+    }
+
+    if (note_id_to_delete.has_value())
+    {
+        documentToEdit->removeNote(note_id_to_delete.value());
 
-        if (juce::Range<double>(note_on_position_in_seconds, note_off_position_in_seconds).contains(query.timeInSeconds))
+        if (editorContext->currentSelectedNoteId == note_id_to_delete.value())
         {
-            note_to_delete = &note;
+            editorContext->currentSelectedNoteId = -1;
         }
     }
 
-    if (note_to_delete != nullptr)
+    sendChangeMessage();
+}
+
+void SongDocumentEditor::quantizeNotes(const cctn::song::QueryForQuantizePianoRollNotes& query)
+{
+    if (documentToEdit.get() == nullptr || (!query.quantizeStart && !query.quantizeEnd))
+    {
+        return;
+    }
+
+    juce::Array<cctn::song::SongDocument::Note> target_notes;
+    std::unordered_set<int> target_note_ids;
+    if (query.noteIds.empty())
+    {
+        target_notes.ensureStorageAllocated(documentToEdit->getNotes().size());
+        for (const auto note : documentToEdit->getNotes())
+        {
+            target_notes.add(note.toNote());
+        }
+    }
+    else
     {
-        documentToEdit->removeNote(note_to_delete);
+        for (const auto note_id : query.noteIds)
+        {
+            const auto note = documentToEdit->findNoteById(note_id);
+            if (note.has_value() && target_note_ids.insert(note_id).second)
+            {
+                target_notes.add(note->toNote());
+            }
+        }
     }
 
+    const auto num_notes = target_notes.size();
+    if (num_notes == 0)
+    {
+        return;
+    }
+
+    juce::ThreadPool* thread_pool = nullptr;
+    if (num_notes >= kMinNumNotesForWorkerPool)
+    {
+        if (workerPool == nullptr)
+        {
+            workerPool = std::make_unique<juce::ThreadPool>();
+        }
+        thread_pool = workerPool.get();
+    }
+
+    // Per note passes only read the document, so they are split across the pool like the snap pass.
+    std::vector<cctn::song::SongDocument::NoteTiming> note_timings((size_t)num_notes);
+    forEachChunkInParallel(num_notes, kMinNumNotesPerJob, thread_pool,
+        [&](int index_begin, int index_end)
+        {
+            for (int i = index_begin; i < index_end; ++i)
+            {
+                note_timings[(size_t)i] = documentToEdit->getNoteTiming(target_notes.getReference(i));
+            }
+        });
+
+    // Snaps ticks of all notes in one sorted pass, then moves each note by strength.
+    std::vector<std::pair<int64_t, int>> sorted_ticks_with_index((size_t)num_notes);
+    std::vector<int64_t> sorted_ticks((size_t)num_notes);
+    std::vector<int64_t> snapped_ticks((size_t)num_notes);
+    std::vector<float> snapped_velocity_scales((size_t)num_notes);
+
+    const auto snap_note_ticks = [&](auto getTick, std::vector<int64_t>& destTicks, std::vector<float>* destVelocityScales)
+        {
+            for (int i = 0; i < num_notes; ++i)
+            {
+                sorted_ticks_with_index[(size_t)i] = { getTick(note_timings[(size_t)i]), i };
+            }
+            std::sort(sorted_ticks_with_index.begin(), sorted_ticks_with_index.end());
+
+            for (int i = 0; i < num_notes; ++i)
+            {
+                sorted_ticks[(size_t)i] = sorted_ticks_with_index[(size_t)i].first;
+            }
+
+            quantizeEngine->snapTicksToNearestGroove(sorted_ticks.data(), snapped_ticks.data(),
+                (destVelocityScales != nullptr) ? snapped_velocity_scales.data() : nullptr, num_notes, thread_pool);
+
+            destTicks.resize((size_t)num_notes);
+            if (destVelocityScales != nullptr)
+            {
+                destVelocityScales->resize((size_t)num_notes);
+            }
+
+            for (int i = 0; i < num_notes; ++i)
+            {
+                const auto original_tick = sorted_ticks[(size_t)i];
+                const auto note_index = (size_t)sorted_ticks_with_index[(size_t)i].second;
+
+                destTicks[note_index] = original_tick + (int64_t)std::llround((double)(snapped_ticks[(size_t)i] - original_tick) * query.strength);
+
+                if (destVelocityScales != nullptr)
+                {
+                    (*destVelocityScales)[note_index] = 1.0f + (snapped_velocity_scales[(size_t)i] - 1.0f) * (float)query.strength;
+                }
+            }
+        };
+
+    std::vector<int64_t> note_on_ticks;
+    std::vector<float> velocity_scales;
+    if (query.quantizeStart)
+    {
+        snap_note_ticks([](const cctn::song::SongDocument::NoteTiming& timing) { return timing.noteOnTick; }, note_on_ticks, &velocity_scales);
+    }
+
+    std::vector<int64_t> note_off_ticks;
+    if (query.quantizeEnd)
+    {
+        snap_note_ticks([](const cctn::song::SongDocument::NoteTiming& timing) { return timing.noteOffTick; }, note_off_ticks, nullptr);
+    }
+
+    // Spans of target notes come first, notes outside a selection follow as fixed neighbours.
+    std::vector<QuantizedNoteSpan> spans((size_t)num_notes);
+    forEachChunkInParallel(num_notes, kMinNumNotesPerJob, thread_pool,
+        [&](int index_begin, int index_end)
+        {
+            for (int i = index_begin; i < index_end; ++i)
+            {
+                const auto& note_timing = note_timings[(size_t)i];
+                const auto original_length = note_timing.noteOffTick - note_timing.noteOnTick;
+
+                const auto note_on_tick = query.quantizeStart ? std::max<int64_t>(note_on_ticks[(size_t)i], 0) : note_timing.noteOnTick;
+                auto note_off_tick = query.quantizeEnd ? note_off_ticks[(size_t)i] : note_on_tick + original_length;
+
+                // Note off snapped onto or before note on keeps its length, at least one tick.
+                if (note_off_tick <= note_on_tick)
+                {
+                    note_off_tick = note_on_tick + std::max<int64_t>(original_length, 1);
+                }
+
+                spans[(size_t)i] = { note_on_tick, note_off_tick, note_timing.noteOnTick, note_timing.noteOffTick, true };
+            }
+        });
+
+    if (!target_note_ids.empty())
+    {
+        auto neighbour_range = juce::Range<int64_t>::emptyRange(spans.front().noteOnTick);
+        for (const auto& span : spans)
+        {
+            neighbour_range = neighbour_range.getUnionWith({ std::min(span.noteOnTick, span.originalNoteOnTick), std::max(span.noteOffTick, span.originalNoteOffTick) });
+        }
+
+        for (const auto note : documentToEdit->findNotesInRange(neighbour_range))
+        {
+            if (target_note_ids.count(note.getId()) == 0)
+            {
+                const auto note_timing = note.getTiming();
+                spans.push_back({ note_timing.noteOnTick, note_timing.noteOffTick, note_timing.noteOnTick, note_timing.noteOffTick, false });
+            }
+        }
+    }
+
+    resolveQuantizedOverlaps(spans);
+
+    forEachChunkInParallel(num_notes, kMinNumNotesPerJob, thread_pool,
+        [&](int index_begin, int index_end)
+        {
+            for (int i = index_begin; i < index_end; ++i)
+            {
+                const auto& span = spans[(size_t)i];
+                if (!span.isMovable)
+                {
+                    // Kept in place, would overlap another note.
+                    continue;
+                }
+
+                auto& note = target_notes.getReference(i);
+                note.startTimeInMusicalTime = cctn::song::SongDocument::Calculator::tickToBar(*documentToEdit.get(), span.noteOnTick);
+                note.duration = cctn::song::SongDocument::NoteDuration((int)(span.noteOffTick - span.noteOnTick));
+
+                if (query.quantizeStart)
+                {
+                    note.velocity = juce::jlimit(1, 127, juce::roundToInt((float)note.velocity * velocity_scales[(size_t)i]));
+                }
+            }
+        });
+
+    // Write back edits the note columns and indices, so it stays on this thread.
+    documentToEdit->updateNotes(target_notes);
+
     sendChangeMessage();
 }
 
+//==============================================================================
+std::vector<int> SongDocumentEditor::findNoteIdsInArea(juce::Range<double> rangeInSeconds, juce::Range<int> noteNumbers) const
+{
+    std::vector<int> note_ids;
+
+    if (documentToEdit.get() == nullptr || rangeInSeconds.getEnd() < 0.0)
+    {
+        return note_ids;
+    }
+
+    const auto range_in_ticks = juce::Range<int64_t>{
+        cctn::song::SongDocument::Calculator::absoluteTimeToTick(*documentToEdit.get(), juce::jmax(rangeInSeconds.getStart(), 0.0)),
+        cctn::song::SongDocument::Calculator::absoluteTimeToTick(*documentToEdit.get(), rangeInSeconds.getEnd()) + 1
+    };
+
+    for (const auto& note : documentToEdit->findNotesInArea(range_in_ticks, noteNumbers))
+    {
+        note_ids.push_back(note.getId());
+    }
+
+    return note_ids;
+}
+
+//==============================================================================
+std::vector<cctn::song::SongDocument::NoteView> SongDocumentEditor::findNoteCandidatesAt(double timeInSeconds, int noteNumber) const
+{
+    if (timeInSeconds < 0.0)
+    {
+        return {};
+    }
+
+    // One extra tick covers rounding of the conversion, callers check exact time range.
+    const auto tick = cctn::song::SongDocument::Calculator::absoluteTimeToTick(*documentToEdit.get(), timeInSeconds);
+
+    return documentToEdit->findNotesInArea({ tick, tick + 2 }, { noteNumber, noteNumber + 1 });
+}
+
 //==============================================================================
 std::optional<cctn::song::SongDocument::RegionWithBeatInfo> SongDocumentEditor::findNearestQuantizeRegion(double timePositionInSeconds) const
 {
     return quantizeEngine->findNearestQuantizeRegion(timePositionInSeconds);
 }
 
+std::optional<size_t> SongDocumentEditor::findQuantizeRegionIndexForInput(double inputTimeInSeconds) const
+{
+    if (documentToEdit.get() == nullptr || inputTimeInSeconds < 0.0)
+    {
+        return std::nullopt;
+    }
+
+    const auto input_tick = cctn::song::SongDocument::Calculator::absoluteTimeToTick(*documentToEdit.get(), inputTimeInSeconds);
+
+    return quantizeEngine->findNearestQuantizeRegionIndexByTick(input_tick);
+}
+
 //==============================================================================
+void SongDocumentEditor::tempoMapChanged(const cctn::song::SongDocument& document)
+{
+    tempoMapPublisher->publish(document);
+}
+
 void SongDocumentEditor::updateEditorContext()
 {
     if (documentToEdit.get() == nullptr)
     {
-        editorContext->currentBeatTimePoints = {};
+        editorContext->currentBeatTimePoints.reset();
+        beatTimePointsCache->clear();
         return;
     }
 
-    editorContext->currentBeatTimePoints = cctn::song::SongDocument::BeatTimePointsFactory::makeBeatTimePoints(*documentToEdit.get(), editorContext->currentGridSize);
-    quantizeEngine->updateQuantizeRegions(editorContext->currentBeatTimePoints);
+    const auto grid = getBeatTimePoints(editorContext->currentGridSize);
+    if (grid != editorContext->currentBeatTimePoints)
+    {
+        // Same grid size on the same document only needs regions after the first changed tick.
+        const auto first_changed_tick = (editorContext->currentBeatTimePoints != nullptr && quantizeRegionsGridSize == editorContext->currentGridSize)
+            ? documentToEdit->findFirstChangedTickSince(quantizeRegionsRevision)
+            : std::nullopt;
+
+        if (first_changed_tick.has_value())
+        {
+            const auto it_first_changed = std::lower_bound(grid->begin(), grid->end(), first_changed_tick.value(),
+                [](const cctn::song::SongDocument::BeatTimePoint& point, int64_t tick)
+                {
+                    return point.absoluteTicks < tick;
+                });
+
+            quantizeEngine->updateQuantizeRegionsFrom(grid, (size_t)std::distance(grid->begin(), it_first_changed));
+        }
+        else
+        {
+            quantizeEngine->updateQuantizeRegions(grid);
+        }
+
+        editorContext->currentBeatTimePoints = grid;
+    }
+
+    quantizeRegionsRevision = documentToEdit->getRevision();
+    quantizeRegionsGridSize = editorContext->currentGridSize;
+
+    if (grooveTableGridSize != editorContext->currentGridSize)
+    {
+        updateGrooveTable();
+    }
+}
+
+void SongDocumentEditor::setGrooveTemplate(const cctn::song::GrooveTemplate& grooveTemplate)
+{
+    editorContext->currentGrooveTemplate = grooveTemplate;
+
+    if (documentToEdit.get() != nullptr)
+    {
+        updateGrooveTable();
+    }
+}
+
+void SongDocumentEditor::updateGrooveTable()
+{
+    const auto ticks_per_step = cctn::song::getTicksPerNoteLength(editorContext->currentGridSize, documentToEdit->getTicksPerQuarterNote());
+    quantizeEngine->setGrooveTemplate(editorContext->currentGrooveTemplate, ticks_per_step);
+
+    grooveTableGridSize = editorContext->currentGridSize;
+}
+
+//==============================================================================
+std::shared_ptr<const cctn::song::SongDocument::BeatTimePoints> SongDocumentEditor::getBeatTimePoints(cctn::song::NoteLength gridSize) const
+{
+    if (documentToEdit.get() == nullptr)
+    {
+        return nullptr;
+    }
+
+    return beatTimePointsCache->getBeatTimePoints(*documentToEdit.get(), gridSize);
 }
 
 }
@@ -6,10 +6,13 @@ namespace song
 {
 
 class QuantizeEngine;
+class TempoMapPublisher;
+class BeatTimePointsCache;
 
 //==============================================================================
 class SongDocumentEditor
     : public juce::ChangeBroadcaster
+    , private cctn::song::SongDocument::TempoMapListener
 {
 public:
     //==============================================================================
@@ -23,18 +26,30 @@ public:
     juce::String debugDumpDocument() const;
 
     //==============================================================================
+    // Hit tests match both time and note number.
     std::optional<cctn::song::SongDocument::Note> findNote(const cctn::song::QueryForFindPianoRollNote& query);
     void selectNote(const cctn::song::QueryForFindPianoRollNote& query);
 
+    // Ids of notes which overlap the time range in the half-open note number range, e.g. for rubber-band selection.
+    std::vector<int> findNoteIdsInArea(juce::Range<double> rangeInSeconds, juce::Range<int> noteNumbers) const;
+
     // CRUD operation
     void createNote(const cctn::song::QueryForAddPianoRollNote& query);
     void readNote(const cctn::song::QueryForAddPianoRollNote& query) {};
     void updateNote(const cctn::song::QueryForAddPianoRollNote& query) {};
     void deleteNoteSingle(const cctn::song::QueryForFindPianoRollNote& query);
 
+    // Moves existing notes to the nearest grid point of current grid and groove, as one document change.
+    void quantizeNotes(const cctn::song::QueryForQuantizePianoRollNotes& query);
+
     //==============================================================================
     std::optional<cctn::song::SongDocument::RegionWithBeatInfo> findNearestQuantizeRegion(double timePositionInSeconds) const;
 
+    // Region for UI input. Input is converted to ticks once and snapped with integer grid arithmetic,
+    // so input preview and created note always agree.
+    std::optional<size_t> findQuantizeRegionIndexForInput(double inputTimeInSeconds) const;
+    const cctn::song::QuantizeEngine& getQuantizeEngine() const { return *quantizeEngine.get(); };
+
     //==============================================================================
     class EditorContext
     {
@@ -42,7 +57,10 @@ public:
         cctn::song::NoteLength currentGridSize{ cctn::song::NoteLength::Quarter };
         cctn::song::NoteLength currentNoteLength{ cctn::song::NoteLength::Quarter };
         cctn::song::NoteLyric currentNoteLyric{ juce::CharPointer_UTF8("\xe3\x83\xa9") }; // ra
-        cctn::song::SongDocument::BeatTimePoints currentBeatTimePoints{};
+        // Whole song grid of currentGridSize, shared with the grid cache. nullptr without document.
+        std::shared_ptr<const cctn::song::SongDocument::BeatTimePoints> currentBeatTimePoints{};
+        // Applied on top of currentGridSize. Change it via setGrooveTemplate.
+        cctn::song::GrooveTemplate currentGrooveTemplate{};
         int currentSelectedNoteId{ -1 };
 
     private:
@@ -51,11 +69,46 @@ public:
     void updateEditorContext();
     EditorContext& getEditorContext() const { return *editorContext.get(); };
 
+    // Rebuilds groove table of quantize engine for current grid size.
+    void setGrooveTemplate(const cctn::song::GrooveTemplate& grooveTemplate);
+
+    //==============================================================================
+    // Tempo map snapshot for realtime threads. Updated with editor context.
+    const cctn::song::TempoMapPublisher& getTempoMapPublisher() const { return *tempoMapPublisher.get(); };
+
+    // Whole song grid of any size, built once per document revision and shared by all views.
+    // Returns nullptr without document.
+    std::shared_ptr<const cctn::song::SongDocument::BeatTimePoints> getBeatTimePoints(cctn::song::NoteLength gridSize) const;
+
 private:
+    //==============================================================================
+    // cctn::song::SongDocument::TempoMapListener
+    void tempoMapChanged(const cctn::song::SongDocument& document) override;
+
+    //==============================================================================
+    void updateGrooveTable();
+
+    // Notes of the note number around the time, found via interval index of the document.
+    std::vector<cctn::song::SongDocument::NoteView> findNoteCandidatesAt(double timeInSeconds, int noteNumber) const;
+
     //==============================================================================
     std::shared_ptr<cctn::song::SongDocument> documentToEdit;
     std::unique_ptr<cctn::song::QuantizeEngine> quantizeEngine;
     std::unique_ptr<EditorContext> editorContext;
+    std::unique_ptr<cctn::song::TempoMapPublisher> tempoMapPublisher;
+    std::unique_ptr<cctn::song::BeatTimePointsCache> beatTimePointsCache;
+
+    // Created on first bulk edit large enough to split.
+    std::unique_ptr<juce::ThreadPool> workerPool;
+    static constexpr int kMinNumNotesForWorkerPool = 8192;
+    static constexpr int kMinNumNotesPerJob = 4096;
+
+    // Document revision and grid size which quantize regions are built from.
+    uint64_t quantizeRegionsRevision{ 0 };
+    cctn::song::NoteLength quantizeRegionsGridSize{ cctn::song::NoteLength::Quarter };
+
+    // Grid size which groove table is built for. Rebuilt only when grid size or template changes.
+    std::optional<cctn::song::NoteLength> grooveTableGridSize;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SongDocumentEditor)
 };
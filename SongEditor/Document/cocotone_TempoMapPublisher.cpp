@@ -0,0 +1,113 @@
+namespace cctn
+{
+namespace song
+{
+
+//==============================================================================
+TempoMapPublisher::TempoMapPublisher()
+{
+}
+
+TempoMapPublisher::~TempoMapPublisher()
+{
+    stopTimer();
+
+    // Readers must not outlive the publisher.
+    jassert(numActiveReaders[0].load() == 0 && numActiveReaders[1].load() == 0);
+
+    currentSnapshot.store(nullptr);
+}
+
+//==============================================================================
+void TempoMapPublisher::publish(const cctn::song::SongDocument& document)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    exchangeSnapshot(std::make_unique<const cctn::song::SongDocument::TempoMap>(document.getTempoMap()));
+}
+
+void TempoMapPublisher::clear()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    exchangeSnapshot(nullptr);
+}
+
+//==============================================================================
+void TempoMapPublisher::timerCallback()
+{
+    releaseRetiredSnapshots();
+}
+
+//==============================================================================
+void TempoMapPublisher::exchangeSnapshot(std::unique_ptr<const cctn::song::SongDocument::TempoMap> newSnapshot)
+{
+    currentSnapshot.store(newSnapshot.get());
+
+    if (ownedSnapshot != nullptr)
+    {
+        retiredSnapshots.push_back({ std::move(ownedSnapshot), currentEpoch.load() });
+    }
+    ownedSnapshot = std::move(newSnapshot);
+
+    releaseRetiredSnapshots();
+}
+
+void TempoMapPublisher::releaseRetiredSnapshots()
+{
+    if (!retiredSnapshots.empty())
+    {
+        const auto epoch = currentEpoch.load();
+
+        // With no reader left from the previous epoch, every live reader registered after
+        // the epoch moved past the snapshots retired before it, so those are unreachable.
+        if (numActiveReaders[(size_t)((epoch - 1) & 1)].load() == 0)
+        {
+            retiredSnapshots.erase(std::remove_if(retiredSnapshots.begin(), retiredSnapshots.end(),
+                [epoch](const RetiredSnapshot& retired) { return retired.retiredEpoch < epoch; }),
+                retiredSnapshots.end());
+
+            // Snapshots retired in this epoch become reclaimable once its readers are gone.
+            currentEpoch.store(epoch + 1);
+        }
+    }
+
+    if (retiredSnapshots.empty())
+    {
+        stopTimer();
+    }
+    else if (!isTimerRunning())
+    {
+        startTimer(kReclaimIntervalMs);
+    }
+}
+
+//==============================================================================
+TempoMapPublisher::ScopedReader::ScopedReader(const TempoMapPublisher& publisher)
+    : owner(publisher)
+{
+    for (;;)
+    {
+        readerEpoch = owner.currentEpoch.load();
+        auto& num_readers = owner.numActiveReaders[(size_t)(readerEpoch & 1)];
+        num_readers.fetch_add(1);
+
+        if (owner.currentEpoch.load() == readerEpoch)
+        {
+            break;
+        }
+
+        // Writer moved to the next epoch meanwhile, register there instead.
+        num_readers.fetch_sub(1);
+    }
+
+    snapshot = owner.currentSnapshot.load();
+}
+
+TempoMapPublisher::ScopedReader::~ScopedReader()
+{
+    owner.numActiveReaders[(size_t)(readerEpoch & 1)].fetch_sub(1);
+}
+
+}
+}
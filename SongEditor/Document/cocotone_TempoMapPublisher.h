@@ -0,0 +1,78 @@
+#pragma once
+
+namespace cctn
+{
+namespace song
+{
+
+//==============================================================================
+// Publishes immutable copies of the document's tempo map to realtime threads.
+// Writer side runs on the message thread. Reader side never blocks and never allocates.
+// Readers register in the current epoch. A retired snapshot is freed once no reader of the epoch
+// it was retired in, or an earlier one, is left. A timer keeps reclaiming while readers are busy.
+class TempoMapPublisher final
+    : private juce::Timer
+{
+public:
+    //==============================================================================
+    TempoMapPublisher();
+    ~TempoMapPublisher() override;
+
+    //==============================================================================
+    // Message thread only.
+    void publish(const cctn::song::SongDocument& document);
+    void clear();
+
+    //==============================================================================
+    // Holds the latest snapshot alive while in scope. Keep the scope short, e.g. one processBlock.
+    class ScopedReader final
+    {
+    public:
+        explicit ScopedReader(const TempoMapPublisher& publisher);
+        ~ScopedReader();
+
+        // Returns nullptr when nothing is published.
+        const cctn::song::SongDocument::TempoMap* get() const { return snapshot; }
+        const cctn::song::SongDocument::TempoMap* operator->() const { return snapshot; }
+        explicit operator bool() const { return snapshot != nullptr; }
+
+    private:
+        const TempoMapPublisher& owner;
+        uint64_t readerEpoch;
+        const cctn::song::SongDocument::TempoMap* snapshot;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedReader)
+    };
+
+private:
+    //==============================================================================
+    // juce::Timer
+    void timerCallback() override;
+
+    //==============================================================================
+    void exchangeSnapshot(std::unique_ptr<const cctn::song::SongDocument::TempoMap> newSnapshot);
+    void releaseRetiredSnapshots();
+
+    static constexpr int kReclaimIntervalMs = 100;
+
+    std::atomic<const cctn::song::SongDocument::TempoMap*> currentSnapshot{ nullptr };
+
+    // Readers count themselves in the slot of their epoch parity. Live readers are
+    // always in the current or the previous epoch.
+    std::atomic<uint64_t> currentEpoch{ 1 };
+    mutable std::array<std::atomic<int>, 2> numActiveReaders{};
+
+    // Owned by message thread.
+    struct RetiredSnapshot
+    {
+        std::unique_ptr<const cctn::song::SongDocument::TempoMap> snapshot;
+        uint64_t retiredEpoch;
+    };
+    std::unique_ptr<const cctn::song::SongDocument::TempoMap> ownedSnapshot;
+    std::vector<RetiredSnapshot> retiredSnapshots;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TempoMapPublisher)
+};
+
+}
+}
@@ -0,0 +1,146 @@
+namespace cctn
+{
+namespace song
+{
+
+//==============================================================================
+namespace
+{
+    struct SeededLyrics
+    {
+        std::vector<juce::String> texts;
+        std::unordered_map<juce::String, int> idsByText;
+    };
+
+    // Built once on first use, read only after that.
+    const SeededLyrics& getSeededLyrics()
+    {
+        static const SeededLyrics seeded_lyrics = []()
+            {
+                SeededLyrics result;
+                result.texts = StaticMoraKana().getMoraKanas();
+
+                for (size_t i = 0; i < result.texts.size(); ++i)
+                {
+                    result.idsByText.emplace(result.texts[i], (int)i);
+                }
+
+                return result;
+            }();
+
+        return seeded_lyrics;
+    }
+}
+
+//==============================================================================
+LyricTable::LyricTable()
+{
+}
+
+LyricTable::~LyricTable()
+{
+}
+
+//==============================================================================
+int LyricTable::acquire(const juce::String& text)
+{
+    const auto found_id = findId(text);
+    if (found_id.has_value())
+    {
+        if (found_id.value() >= getNumSeededLyrics())
+        {
+            ++addedTexts[(size_t)(found_id.value() - getNumSeededLyrics())].useCount;
+        }
+
+        return found_id.value();
+    }
+
+    int lyric_id;
+    if (!releasedIds.empty())
+    {
+        lyric_id = releasedIds.back();
+        releasedIds.pop_back();
+    }
+    else
+    {
+        lyric_id = size();
+        addedTexts.emplace_back();
+    }
+
+    addedTexts[(size_t)(lyric_id - getNumSeededLyrics())] = { text, 1, false };
+    addedIdsByText.emplace(text, lyric_id);
+
+    return lyric_id;
+}
+
+void LyricTable::release(int lyricId)
+{
+    jassert(isValidId(lyricId));
+
+    if (lyricId < getNumSeededLyrics())
+    {
+        return;
+    }
+
+    auto& added_lyric = addedTexts[(size_t)(lyricId - getNumSeededLyrics())];
+    jassert(added_lyric.useCount > 0);
+
+    if (--added_lyric.useCount > 0)
+    {
+        return;
+    }
+
+    addedIdsByText.erase(added_lyric.text);
+    added_lyric = { juce::String(), 0, true };
+    releasedIds.push_back(lyricId);
+}
+
+std::optional<int> LyricTable::findId(const juce::String& text) const
+{
+    const auto& seeded_ids = getSeededLyrics().idsByText;
+    const auto it_seeded = seeded_ids.find(text);
+    if (it_seeded != seeded_ids.end())
+    {
+        return it_seeded->second;
+    }
+
+    const auto it_added = addedIdsByText.find(text);
+    if (it_added != addedIdsByText.end())
+    {
+        return it_added->second;
+    }
+
+    return std::nullopt;
+}
+
+const juce::String& LyricTable::getText(int lyricId) const
+{
+    jassert(isValidId(lyricId));
+
+    const auto& seeded_texts = getSeededLyrics().texts;
+    if (lyricId < (int)seeded_texts.size())
+    {
+        return seeded_texts[(size_t)lyricId];
+    }
+
+    return addedTexts[(size_t)(lyricId - (int)seeded_texts.size())].text;
+}
+
+bool LyricTable::isValidId(int lyricId) const
+{
+    if (lyricId < 0 || lyricId >= size())
+    {
+        return false;
+    }
+
+    return lyricId < getNumSeededLyrics() || !addedTexts[(size_t)(lyricId - getNumSeededLyrics())].isReleased;
+}
+
+//==============================================================================
+int LyricTable::getNumSeededLyrics()
+{
+    return (int)getSeededLyrics().texts.size();
+}
+
+}
+}
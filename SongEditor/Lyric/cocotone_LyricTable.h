@@ -0,0 +1,52 @@
+#pragma once
+
+namespace cctn
+{
+namespace song
+{
+
+//==============================================================================
+// Lyric texts of one document, stored once and referred to by a compact id.
+// Ids below getNumSeededLyrics() are the mora kana. They are the same in every document
+// and the texts are shared, so copying a table copies only lyrics outside the kana.
+// Other texts are counted by the stored notes which use them. A text released by its last note
+// is dropped and its id reused by the next new text, so an edited lyric doesn't leave its old text behind.
+class LyricTable final
+{
+public:
+    //==============================================================================
+    LyricTable();
+    ~LyricTable();
+
+    //==============================================================================
+    // Id of the text, added when not yet in the table. Every acquire is paired with a release.
+    int acquire(const juce::String& text);
+    void release(int lyricId);
+
+    std::optional<int> findId(const juce::String& text) const;
+
+    const juce::String& getText(int lyricId) const;
+    bool isValidId(int lyricId) const;
+    int size() const { return getNumSeededLyrics() + (int)addedTexts.size(); }
+
+    //==============================================================================
+    static int getNumSeededLyrics();
+
+private:
+    //==============================================================================
+    struct AddedLyric
+    {
+        juce::String text;
+        int useCount{ 0 };
+        bool isReleased{ false };
+    };
+
+    std::vector<AddedLyric> addedTexts;
+    std::unordered_map<juce::String, int> addedIdsByText;
+    std::vector<int> releasedIds;
+
+    JUCE_LEAK_DETECTOR(LyricTable)
+};
+
+}
+}
@@ -3,6 +3,26 @@ namespace cctn
 namespace song
 {
 
+//==============================================================================
+namespace
+{
+    // Last start at or before the value, or 0. Compiles to conditional move, no branch to mispredict.
+    template <typename ValueType>
+    forcedinline size_t findLastStartAtOrBefore(const ValueType* starts, size_t numStarts, ValueType value)
+    {
+        const ValueType* base = starts;
+        size_t length = numStarts;
+        while (length > 1)
+        {
+            const auto half = length / 2;
+            base = (base[half] <= value) ? base + half : base;
+            length -= half;
+        }
+
+        return (size_t)(base - starts);
+    }
+}
+
 //==============================================================================
 QuantizeEngine::QuantizeEngine()
 {
@@ -13,54 +33,200 @@ QuantizeEngine::~QuantizeEngine()
 }
 
 //==============================================================================
-void QuantizeEngine::updateQuantizeRegions(const cctn::song::SongDocument::BeatTimePoints& beatTimePoints)
+void QuantizeEngine::updateQuantizeRegions(std::shared_ptr<const cctn::song::SongDocument::BeatTimePoints> beatTimePoints)
+{
+    updateQuantizeRegionsFrom(std::move(beatTimePoints), 0);
+}
+
+void QuantizeEngine::updateQuantizeRegionsFrom(std::shared_ptr<const cctn::song::SongDocument::BeatTimePoints> beatTimePoints, size_t firstChangedPointIndex)
 {
-    quantizeRegions.clear();
+    sourceBeatTimePoints = std::move(beatTimePoints);
 
-    if (beatTimePoints.size() < 2)
+    const auto num_points = (sourceBeatTimePoints != nullptr) ? sourceBeatTimePoints->size() : 0;
+    const auto num_kept_points = std::min({ firstChangedPointIndex, num_points, regionStartTimesInSeconds.size() });
+
+    regionStartTimesInSeconds.resize(num_points);
+    regionStartTicks.resize(num_points);
+    regionStepIndicesInBar.resize(num_points);
+
+    for (size_t i = num_kept_points; i < num_points; ++i)
     {
-        return;
+        const auto& point = (*sourceBeatTimePoints)[i];
+        regionStartTimesInSeconds[i] = point.absoluteTimeInSeconds;
+        regionStartTicks[i] = point.absoluteTicks;
+
+        // Grid restarts at every bar line, so steps are counted from there.
+        const auto is_bar_start = (i == 0) || ((*sourceBeatTimePoints)[i - 1].musicalTime.bar != point.musicalTime.bar);
+        regionStepIndicesInBar[i] = is_bar_start ? 0 : regionStepIndicesInBar[i - 1] + 1;
     }
+}
 
-    for (size_t i = 0; i < beatTimePoints.size() - 1; ++i)
+//==============================================================================
+std::optional<size_t> QuantizeEngine::findNearestQuantizeRegionIndex(double timePositionInSeconds) const
+{
+    const auto num_regions = getNumQuantizeRegions();
+    if (num_regions == 0 || timePositionInSeconds < 0.0)
     {
-        cctn::song::SongDocument::RegionWithBeatInfo region;
-        region.startPositionInSeconds = beatTimePoints[i].absoluteTimeInSeconds;
-        region.endPositionInSeconds = beatTimePoints[i + 1].absoluteTimeInSeconds;
-        region.startMusicalTime = beatTimePoints[i].musicalTime;
-        quantizeRegions.add(region);
+        return std::nullopt;
     }
+
+    return findLastStartAtOrBefore(regionStartTimesInSeconds.data(), num_regions, timePositionInSeconds);
 }
 
-std::optional<cctn::song::SongDocument::RegionWithBeatInfo> QuantizeEngine::findNearestQuantizeRegion(double timePositionInSeconds) const
+std::optional<size_t> QuantizeEngine::findNearestQuantizeRegionIndexByTick(int64_t tickPosition) const
 {
-    if (quantizeRegions.isEmpty() || timePositionInSeconds < 0.0)
+    const auto num_regions = getNumQuantizeRegions();
+    if (num_regions == 0 || tickPosition < 0)
     {
         return std::nullopt;
     }
 
-    // Find the first region whose end is greater than the given time
-    auto it = std::lower_bound(quantizeRegions.begin(), quantizeRegions.end(), timePositionInSeconds,
-        [](const cctn::song::SongDocument::RegionWithBeatInfo& region, double time) {
-            return region.endPositionInSeconds <= time;
-        });
+    return findLastStartAtOrBefore(regionStartTicks.data(), num_regions, tickPosition);
+}
 
-    if (it == quantizeRegions.begin())
+std::optional<cctn::song::SongDocument::RegionWithBeatInfo> QuantizeEngine::findNearestQuantizeRegion(double timePositionInSeconds) const
+{
+    const auto region_index = findNearestQuantizeRegionIndex(timePositionInSeconds);
+    if (!region_index.has_value())
     {
-        // If the time is before or at the start of the first region
-        return quantizeRegions.getFirst();
+        return std::nullopt;
     }
-    else if (it == quantizeRegions.end())
+
+    cctn::song::SongDocument::RegionWithBeatInfo region;
+    region.startPositionInSeconds = getRegionStartInSeconds(region_index.value());
+    region.endPositionInSeconds = getRegionEndInSeconds(region_index.value());
+    region.startMusicalTime = getRegionStartMusicalTime(region_index.value());
+
+    return region;
+}
+
+//==============================================================================
+template <typename ValueType, typename RegionCallback>
+void QuantizeEngine::forEachRegionOfSortedValues(const std::vector<ValueType>& regionStarts, const ValueType* sortedValues, int numValues, juce::ThreadPool* threadPool, RegionCallback&& callback) const
+{
+    jassert(std::is_sorted(sortedValues, sortedValues + numValues));
+
+    const auto num_regions = getNumQuantizeRegions();
+    if (num_regions == 0 || numValues <= 0)
     {
-        // If the time is after the end of the last region
-        return quantizeRegions.getLast();
+        return;
     }
-    else
+
+    // Search once for the first value, then walk regions along with values.
+    const auto process_values = [&](int index_begin, int index_end)
+        {
+            if (index_begin >= index_end)
+            {
+                return;
+            }
+
+            auto region_index = findLastStartAtOrBefore(regionStarts.data(), num_regions, sortedValues[index_begin]);
+            for (int i = index_begin; i < index_end; ++i)
+            {
+                while (region_index + 1 < num_regions && regionStarts[region_index + 1] <= sortedValues[i])
+                {
+                    ++region_index;
+                }
+
+                callback(i, region_index);
+            }
+        };
+
+    forEachChunkInParallel(numValues, kMinNumValuesPerJob, threadPool, process_values);
+}
+
+void QuantizeEngine::findNearestQuantizeRegionIndices(const double* sortedTimesInSeconds, size_t* destRegionIndices, int numValues, juce::ThreadPool* threadPool) const
+{
+    forEachRegionOfSortedValues(regionStartTimesInSeconds, sortedTimesInSeconds, numValues, threadPool,
+        [destRegionIndices](int valueIndex, size_t regionIndex)
+        {
+            destRegionIndices[valueIndex] = regionIndex;
+        });
+}
+
+void QuantizeEngine::snapTimesToQuantizeGrid(const double* sortedTimesInSeconds, double* destTimesInSeconds, int numValues, juce::ThreadPool* threadPool) const
+{
+    forEachRegionOfSortedValues(regionStartTimesInSeconds, sortedTimesInSeconds, numValues, threadPool,
+        [this, destTimesInSeconds](int valueIndex, size_t regionIndex)
+        {
+            destTimesInSeconds[valueIndex] = regionStartTimesInSeconds[regionIndex];
+        });
+}
+
+void QuantizeEngine::snapTicksToQuantizeGrid(const int64_t* sortedTicks, int64_t* destTicks, int numValues, juce::ThreadPool* threadPool) const
+{
+    forEachRegionOfSortedValues(regionStartTicks, sortedTicks, numValues, threadPool,
+        [this, destTicks](int valueIndex, size_t regionIndex)
+        {
+            destTicks[valueIndex] = regionStartTicks[regionIndex];
+        });
+}
+
+//==============================================================================
+void QuantizeEngine::setGrooveTemplate(const cctn::song::GrooveTemplate& grooveTemplate, int64_t ticksPerStep)
+{
+    jassert(grooveTemplate.stepOffsets.size() == grooveTemplate.stepVelocityScales.size());
+    jassert(ticksPerStep > 0);
+
+    const auto num_steps = std::min(grooveTemplate.stepOffsets.size(), grooveTemplate.stepVelocityScales.size());
+
+    grooveTickOffsets.resize(num_steps);
+    grooveVelocityScales.resize(num_steps);
+
+    for (size_t step = 0; step < num_steps; ++step)
     {
-        // Return the region that contains the time or the previous one
-        return (timePositionInSeconds < it->startPositionInSeconds) ? *(--it) : *it;
+        grooveTickOffsets[step] = (int64_t)std::llround(grooveTemplate.stepOffsets[step] * (double)ticksPerStep);
+        grooveVelocityScales[step] = grooveTemplate.stepVelocityScales[step];
     }
 }
 
+void QuantizeEngine::snapTicksToGroove(const int64_t* sortedTicks, int64_t* destTicks, float* destVelocityScales, int numValues, juce::ThreadPool* threadPool) const
+{
+    snapTicksToGridPoints(sortedTicks, destTicks, destVelocityScales, numValues, threadPool, false);
+}
+
+void QuantizeEngine::snapTicksToNearestGroove(const int64_t* sortedTicks, int64_t* destTicks, float* destVelocityScales, int numValues, juce::ThreadPool* threadPool) const
+{
+    snapTicksToGridPoints(sortedTicks, destTicks, destVelocityScales, numValues, threadPool, true);
+}
+
+void QuantizeEngine::snapTicksToGridPoints(const int64_t* sortedTicks, int64_t* destTicks, float* destVelocityScales, int numValues, juce::ThreadPool* threadPool, bool toNearestPoint) const
+{
+    const auto num_groove_steps = grooveTickOffsets.size();
+
+    forEachRegionOfSortedValues(regionStartTicks, sortedTicks, numValues, threadPool,
+        [this, sortedTicks, destTicks, destVelocityScales, num_groove_steps, toNearestPoint](int valueIndex, size_t regionIndex)
+        {
+            const auto value = sortedTicks[valueIndex];
+
+            // Ties go to the earlier point.
+            auto point_index = regionIndex;
+            if (toNearestPoint && regionStartTicks[regionIndex + 1] - value < value - regionStartTicks[regionIndex])
+            {
+                ++point_index;
+            }
+
+            if (num_groove_steps == 0)
+            {
+                destTicks[valueIndex] = regionStartTicks[point_index];
+
+                if (destVelocityScales != nullptr)
+                {
+                    destVelocityScales[valueIndex] = 1.0f;
+                }
+                return;
+            }
+
+            const auto groove_step = (size_t)regionStepIndicesInBar[point_index] % num_groove_steps;
+
+            destTicks[valueIndex] = regionStartTicks[point_index] + grooveTickOffsets[groove_step];
+
+            if (destVelocityScales != nullptr)
+            {
+                destVelocityScales[valueIndex] = grooveVelocityScales[groove_step];
+            }
+        });
+}
+
 }
 }
@@ -6,6 +6,8 @@ namespace song
 {
 
 //==============================================================================
+// Region i spans grid point i to point i + 1. Lookups return region index.
+// Start times and ticks are kept as flat arrays for search, musical time is read from the shared grid.
 class QuantizeEngine final
 {
 public:
@@ -14,12 +16,66 @@ public:
     ~QuantizeEngine();
 
     //==============================================================================
-    void updateQuantizeRegions(const cctn::song::SongDocument::BeatTimePoints& beatTimePoints);
+    void updateQuantizeRegions(std::shared_ptr<const cctn::song::SongDocument::BeatTimePoints> beatTimePoints);
+
+    // Keeps regions which end before the given point and rebuilds the rest.
+    void updateQuantizeRegionsFrom(std::shared_ptr<const cctn::song::SongDocument::BeatTimePoints> beatTimePoints, size_t firstChangedPointIndex);
+
+    //==============================================================================
+    // Region which contains the time. Clamped to first or last region.
+    std::optional<size_t> findNearestQuantizeRegionIndex(double timePositionInSeconds) const;
+    std::optional<size_t> findNearestQuantizeRegionIndexByTick(int64_t tickPosition) const;
+
+    size_t getNumQuantizeRegions() const { return regionStartTimesInSeconds.size() > 1 ? regionStartTimesInSeconds.size() - 1 : 0; }
+    double getRegionStartInSeconds(size_t regionIndex) const { return regionStartTimesInSeconds[regionIndex]; }
+    double getRegionEndInSeconds(size_t regionIndex) const { return regionStartTimesInSeconds[regionIndex + 1]; }
+    int64_t getRegionStartInTicks(size_t regionIndex) const { return regionStartTicks[regionIndex]; }
+    int64_t getRegionEndInTicks(size_t regionIndex) const { return regionStartTicks[regionIndex + 1]; }
+    const cctn::song::SongDocument::MusicalTime& getRegionStartMusicalTime(size_t regionIndex) const { return (*sourceBeatTimePoints)[regionIndex].musicalTime; }
+
+    // Copy of the region, for callers which keep it beyond next update.
     std::optional<cctn::song::SongDocument::RegionWithBeatInfo> findNearestQuantizeRegion(double timePositionInSeconds) const;
 
+    //==============================================================================
+    // Batch lookup over ascending sorted values in one merge pass. Values before the grid map to the first region.
+    // Large inputs are split into chunks shared by the calling thread and the given pool. Returns when all values are done.
+    // Without any region, destination is left untouched.
+    void findNearestQuantizeRegionIndices(const double* sortedTimesInSeconds, size_t* destRegionIndices, int numValues, juce::ThreadPool* threadPool = nullptr) const;
+
+    // Snap to start of the region which contains the value.
+    void snapTimesToQuantizeGrid(const double* sortedTimesInSeconds, double* destTimesInSeconds, int numValues, juce::ThreadPool* threadPool = nullptr) const;
+    void snapTicksToQuantizeGrid(const int64_t* sortedTicks, int64_t* destTicks, int numValues, juce::ThreadPool* threadPool = nullptr) const;
+
+    //==============================================================================
+    // Converts the template to tick offsets for the given grid step, once per template and grid size.
+    void setGrooveTemplate(const cctn::song::GrooveTemplate& grooveTemplate, int64_t ticksPerStep);
+
+    // Snap to grid and shift by groove offset of the step in its bar. destVelocityScales may be nullptr.
+    void snapTicksToGroove(const int64_t* sortedTicks, int64_t* destTicks, float* destVelocityScales, int numValues, juce::ThreadPool* threadPool = nullptr) const;
+
+    // Same as snapTicksToGroove, but to the nearer grid point around each value. For moving existing notes.
+    void snapTicksToNearestGroove(const int64_t* sortedTicks, int64_t* destTicks, float* destVelocityScales, int numValues, juce::ThreadPool* threadPool = nullptr) const;
+
 private:
     //==============================================================================
-    juce::Array<cctn::song::SongDocument::RegionWithBeatInfo> quantizeRegions;
+    template <typename ValueType, typename RegionCallback>
+    void forEachRegionOfSortedValues(const std::vector<ValueType>& regionStarts, const ValueType* sortedValues, int numValues, juce::ThreadPool* threadPool, RegionCallback&& callback) const;
+
+    void snapTicksToGridPoints(const int64_t* sortedTicks, int64_t* destTicks, float* destVelocityScales, int numValues, juce::ThreadPool* threadPool, bool toNearestPoint) const;
+
+    static constexpr int kMinNumValuesPerJob = 4096;
+
+    //==============================================================================
+    std::shared_ptr<const cctn::song::SongDocument::BeatTimePoints> sourceBeatTimePoints;
+
+    // One entry per grid point. Last entry is the end of the last region.
+    std::vector<double> regionStartTimesInSeconds;
+    std::vector<int64_t> regionStartTicks;
+    std::vector<int> regionStepIndicesInBar;
+
+    // Groove table for one cycle of steps. Empty when straight.
+    std::vector<int64_t> grooveTickOffsets;
+    std::vector<float> grooveVelocityScales;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(QuantizeEngine)
 };
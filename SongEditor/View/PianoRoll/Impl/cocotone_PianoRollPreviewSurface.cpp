@@ -17,6 +17,7 @@ PianoRollPreviewSurface::PianoRollPreviewSurface(const PianoRollKeyboard& pianoR
     , scopedAudioThumbnailPtrToPaint(nullptr)
     , visibleGridVerticalLineType(juce::var((int)VisibleGridVerticalType::kTimeSignature))
     , selectedNoteId(-1)
+    , hoveredNoteId(-1)
 {
     numVisibleWhiteAndBlackKeys = 12 * numVisibleOctaves;
     numVisibleWhiteKeys = 7 * numVisibleOctaves;
@@ -269,50 +270,52 @@ void PianoRollPreviewSurface::updateViewContext()
         return;
     }
 
-    const auto& notes = scopedSongDocumentPtrToPaint->getNotes();
-
-    // Update input position is insertable or not.
+    // Update input position is insertable or not, and note under the mouse.
+    // One extra tick covers rounding of the conversion, exact time range is checked below.
+    const auto input_tick = cctn::song::SongDocument::Calculator::absoluteTimeToTick(*scopedSongDocumentPtrToPaint, juce::jmax(userInputPositionInSeconds, 0.0));
+    // Vocal line is monophonic, so any note at the time blocks input. Hover only matches the key under the mouse.
     isInputPositionInsertable = true;
-    for (const auto& note : notes)
+    hoveredNoteId = -1;
+    for (const auto& note : scopedSongDocumentPtrToPaint->findNotesInRange({ input_tick, input_tick + 2 }))
     {
-        const cctn::song::SongDocument& document = *scopedSongDocumentPtrToPaint;
-
-        const auto musical_time_note_on = note.startTimeInMusicalTime;
-        const int64_t tickOnPosition = cctn::song::SongDocument::Calculator::barToTick(document, musical_time_note_on);
-
-        const auto musical_time_note_off = cctn::song::SongDocument::Calculator::calculateNoteOffPosition(document, note);
-        const int64_t tickOffPosition = cctn::song::SongDocument::Calculator::barToTick(document, musical_time_note_off);
-
-        const double start_position_in_seconds = cctn::song::SongDocument::Calculator::tickToAbsoluteTime(document, tickOnPosition);
-        const double end_position_in_seconds = cctn::song::SongDocument::Calculator::tickToAbsoluteTime(document, tickOffPosition);
+        const auto note_timing = note.getTiming();
 
-        if (juce::Range<float>(start_position_in_seconds, end_position_in_seconds).contains(userInputPositionInSeconds))
+        if (juce::Range<float>(note_timing.noteOnTimeInSeconds, note_timing.noteOffTimeInSeconds).contains(userInputPositionInSeconds))
         {
             isInputPositionInsertable = false;
-            break;
+
+            if (note.getNoteNumber() == userInputPositionInNoteNumber)
+            {
+                hoveredNoteId = note.getId();
+                break;
+            }
         }
     }
 
-    currentBeatTimePoints = documentEditorForPreviewPtr.lock()->getEditorContext().currentBeatTimePoints;
+    // Shared whole song grid, drawn only in visible range.
+    const auto grid_size = documentEditorForPreviewPtr.lock()->getEditorContext().currentGridSize;
+    currentBeatTimePoints = documentEditorForPreviewPtr.lock()->getBeatTimePoints(grid_size);
 
     // Update input region in seconds
     quantizedInputRegionInSeconds = juce::Range<double>{ 0.0f, 0.0f };
     if (!documentEditorForPreviewPtr.expired() &&
         documentEditorForPreviewPtr.lock()->getCurrentDocument().has_value())
     {
-        const auto region_optional = documentEditorForPreviewPtr.lock()->findNearestQuantizeRegion(userInputPositionInSeconds);
-        if (region_optional.has_value())
+        // Same lookup as SongDocumentEditor::createNote, so preview matches the note to be created.
+        const auto& quantize_engine = documentEditorForPreviewPtr.lock()->getQuantizeEngine();
+        const auto region_index = documentEditorForPreviewPtr.lock()->findQuantizeRegionIndexForInput(userInputPositionInSeconds);
+        if (region_index.has_value())
         {
             const auto& document = *documentEditorForPreviewPtr.lock()->getCurrentDocument().value();
             const auto note_length = documentEditorForPreviewPtr.lock()->getEditorContext().currentNoteLength;
-            const auto tick_of_region_start = cctn::song::SongDocument::Calculator::barToTick(document, region_optional.value().startMusicalTime);
-            const auto tick_of_region_end = 
-                tick_of_region_start + 
-                cctn::song::SongDocument::Calculator::noteLengthToTicks(document, note_length);
-            
-            quantizedInputRegionInSeconds = 
-                juce::Range<double>{ 
-                cctn::song::SongDocument::Calculator::tickToAbsoluteTime(document, tick_of_region_start), 
+            const auto tick_of_region_end =
+                quantize_engine.getRegionStartInTicks(region_index.value()) +
+                cctn::song::getTicksPerNoteLength(note_length, document.getTicksPerQuarterNote());
+
+            // Start is already on the grid, only the end needs the tempo map.
+            quantizedInputRegionInSeconds =
+                juce::Range<double>{
+                quantize_engine.getRegionStartInSeconds(region_index.value()),
                 cctn::song::SongDocument::Calculator::tickToAbsoluteTime(document, tick_of_region_end)
             };
         }
@@ -421,12 +424,12 @@ void PianoRollPreviewSurface::drawGridVerticalLinesInTimeSignatureDomain(juce::G
 {
     juce::Graphics::ScopedSaveState save_state(g);
 
-    if (scopedSongDocumentPtrToPaint == nullptr)
+    if (scopedSongDocumentPtrToPaint == nullptr || currentBeatTimePoints == nullptr)
     {
         return;
     }
 
-    const auto& precise_beat_and_time_array = currentBeatTimePoints;
+    const auto& precise_beat_and_time_array = *currentBeatTimePoints;
 
     const auto vertical_line_positions = createVerticalLinePositionsInTimeSignatureDomain(rangeVisibleTimeInSeconds, precise_beat_and_time_array, getWidth());
 
@@ -451,11 +454,16 @@ void PianoRollPreviewSurface::drawCurrentPreviewData(juce::Graphics& g)
         return;
     }
 
-    const auto& notes = scopedSongDocumentPtrToPaint->getNotes();
+    // Only notes in visible range and keys.
+    const auto visible_note_numbers = juce::Range<int>{ (int)rangeVisibleKeyNoteNumbers.getStart(), (int)rangeVisibleKeyNoteNumbers.getEnd() };
+    const auto visible_range_in_ticks = juce::Range<int64_t>{
+        cctn::song::SongDocument::Calculator::absoluteTimeToTick(*scopedSongDocumentPtrToPaint, juce::jmax(rangeVisibleTimeInSeconds.getStart(), 0.0)),
+        cctn::song::SongDocument::Calculator::absoluteTimeToTick(*scopedSongDocumentPtrToPaint, juce::jmax(rangeVisibleTimeInSeconds.getEnd(), 0.0)) + 1
+    };
 
-    for (const auto& note : notes)
+    for (const auto& note : scopedSongDocumentPtrToPaint->findNotesInArea(visible_range_in_ticks, visible_note_numbers))
     {
-        const auto note_draw_info = createNoteDrawInfo(*scopedSongDocumentPtrToPaint, note, rangeVisibleTimeInSeconds, 0, getWidth());
+        const auto note_draw_info = createNoteDrawInfo(note, rangeVisibleTimeInSeconds, 0, getWidth());
         
         juce::Range<float> key_position_range = juce::Range<float>{ 0.0f, 0.0f };
         if (mapVisibleKeyNoteNumberToVerticalPositionRangeAsVerticalTopToBottom.count(note_draw_info.noteNumber) > 0)
@@ -473,7 +481,7 @@ void PianoRollPreviewSurface::drawCurrentPreviewData(juce::Graphics& g)
         g.setColour(kColourGridNote);
         g.fillRect(rect_to_fill);
 
-        if (rect_to_fill.contains(lastMousePosition.getX(), lastMousePosition.getY()))
+        if (note_draw_info.noteId == hoveredNoteId)
         {
             g.setColour(kColourGridNote.brighter());
             g.fillRect(rect_to_fill);
@@ -747,18 +755,13 @@ PianoRollPreviewSurface::createVerticalLinePositionsInTimeSignatureDomain(const
 
 //==============================================================================
 PianoRollPreviewSurface::NoteDrawInfo
-PianoRollPreviewSurface::createNoteDrawInfo(const cctn::song::SongDocument& document, const cctn::song::SongDocument::Note& note, const juce::Range<double> visibleRangeSeconds, int positionLeft, int positionRight)
+PianoRollPreviewSurface::createNoteDrawInfo(const cctn::song::SongDocument::NoteView& note, const juce::Range<double> visibleRangeSeconds, int positionLeft, int positionRight)
 {
     NoteDrawInfo result;
     
-    const auto musical_time_note_on = note.startTimeInMusicalTime;
-    const int64_t tickOnPosition = cctn::song::SongDocument::Calculator::barToTick(document, musical_time_note_on);
-
-    const auto musical_time_note_off = cctn::song::SongDocument::Calculator::calculateNoteOffPosition(document, note);
-    const int64_t tickOffPosition = cctn::song::SongDocument::Calculator::barToTick(document, musical_time_note_off);
-
-    const double start_position_in_seconds = cctn::song::SongDocument::Calculator::tickToAbsoluteTime(document, tickOnPosition);
-    const double end_position_in_seconds = cctn::song::SongDocument::Calculator::tickToAbsoluteTime(document, tickOffPosition);
+    const auto note_timing = note.getTiming();
+    const double start_position_in_seconds = note_timing.noteOnTimeInSeconds;
+    const double end_position_in_seconds = note_timing.noteOffTimeInSeconds;
 
     // Convert time to position X.
     const double rect_left_x =
@@ -769,9 +772,9 @@ PianoRollPreviewSurface::createNoteDrawInfo(const cctn::song::SongDocument& docu
 
     result.positionLeftX = rect_left_x;
     result.positionRightX = rect_right_x;
-    result.lyric = note.lyric;
-    result.noteNumber = note.noteNumber;
-    result.noteId = note.id;
+    result.lyric = note.getLyric();
+    result.noteNumber = note.getNoteNumber();
+    result.noteId = note.getId();
 
     return result;
 }
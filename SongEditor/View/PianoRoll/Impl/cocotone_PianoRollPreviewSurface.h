@@ -99,7 +99,7 @@ private:
 
         JUCE_LEAK_DETECTOR(NoteDrawInfo)
     };
-    static NoteDrawInfo createNoteDrawInfo(const cctn::song::SongDocument& document, const cctn::song::SongDocument::Note& note, const juce::Range<double> visibleRangeSeconds, int positionLeft, int positionRight);
+    static NoteDrawInfo createNoteDrawInfo(const cctn::song::SongDocument::NoteView& note, const juce::Range<double> visibleRangeSeconds, int positionLeft, int positionRight);
 
     //==============================================================================
     // TODO: Move state value.
@@ -113,6 +113,7 @@ private:
     int userInputPositionInNoteNumber;
     bool isInputPositionInsertable;
     int selectedNoteId;
+    int hoveredNoteId;
     juce::Point<int> lastMousePosition;
     juce::Range<double> quantizedInputRegionInSeconds;
 
@@ -127,7 +128,7 @@ private:
 
     std::weak_ptr<cctn::song::SongDocumentEditor> documentEditorForPreviewPtr;
     const cctn::song::SongDocument* scopedSongDocumentPtrToPaint;
-    cctn::song::SongDocument::BeatTimePoints currentBeatTimePoints{};
+    std::shared_ptr<const cctn::song::SongDocument::BeatTimePoints> currentBeatTimePoints{};
 
     // TODO: should abstract
     juce::AudioPlayHead::PositionInfo currentPositionInfo;
@@ -184,7 +184,7 @@ void PianoRollTimeRuler::updateViewContext()
         return;
     }
 
-    currentBeatTimePoints = documentEditorForPreviewPtr.lock()->getEditorContext().currentBeatTimePoints;
+    currentGridSize = documentEditorForPreviewPtr.lock()->getEditorContext().currentGridSize;
 }
 
 //==============================================================================
@@ -211,7 +211,10 @@ void PianoRollTimeRuler::drawBeatRulerVerticalLines(juce::Graphics& g)
 {
     juce::Graphics::ScopedSaveState save_state(g);
 
-    const auto precise_beat_and_time_array = currentBeatTimePoints;
+    if (scopedSongDocumentPtrToPaint == nullptr)
+    {
+        return;
+    }
 
     // Set clipping mask
     g.reduceClipRegion(rectBeatRulerArea);
@@ -219,8 +222,10 @@ void PianoRollTimeRuler::drawBeatRulerVerticalLines(juce::Graphics& g)
     g.setFont(juce::Font(juce::Font::getDefaultMonospacedFontName(), 10, 0));
 
     juce::String last_beat_signature = "";
-    for (const auto& beat_time_point : precise_beat_and_time_array)
+    auto it = cctn::song::SongDocument::BeatTimePointsFactory::makeBeatTimePointIteratorAtTime(*scopedSongDocumentPtrToPaint, currentGridSize, rangeVisibleTimeInSeconds.getStart());
+    for (; it->absoluteTimeInSeconds <= rangeVisibleTimeInSeconds.getEnd(); ++it)
     {
+        const auto& beat_time_point = *it;
         const auto time_in_seconds = beat_time_point.absoluteTimeInSeconds;
 
         const auto signature_text = " " +
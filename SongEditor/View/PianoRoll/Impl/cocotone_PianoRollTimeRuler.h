@@ -85,7 +85,7 @@ private:
     //==============================================================================
     std::weak_ptr<cctn::song::SongDocumentEditor> documentEditorForPreviewPtr;
     const cctn::song::SongDocument* scopedSongDocumentPtrToPaint;
-    cctn::song::SongDocument::BeatTimePoints currentBeatTimePoints{};
+    cctn::song::NoteLength currentGridSize{ cctn::song::NoteLength::Quarter };
 
     // TODO: should abstract
     juce::AudioPlayHead::PositionInfo currentPositionInfo;
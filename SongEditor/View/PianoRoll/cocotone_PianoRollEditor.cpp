@@ -203,8 +203,12 @@ void PianoRollEditor::registerSongDocumentEditor(std::shared_ptr<cctn::song::Son
 
         valuePianoRollInputMora = songDocumentEditorPtr.lock()->getEditorContext().currentNoteLyric.text;
 
-        const auto document_tail_seconds = songDocumentEditorPtr.lock()->getEditorContext().currentBeatTimePoints.back().absoluteTimeInSeconds;
-        pianoRollScrollBarHorizontal->setRangeLimits(juce::Range<double>{0.0, document_tail_seconds}, juce::dontSendNotification);
+        const auto& beat_time_points = songDocumentEditorPtr.lock()->getEditorContext().currentBeatTimePoints;
+        if (beat_time_points != nullptr && !beat_time_points->empty())
+        {
+            const auto document_tail_seconds = beat_time_points->back().absoluteTimeInSeconds;
+            pianoRollScrollBarHorizontal->setRangeLimits(juce::Range<double>{0.0, document_tail_seconds}, juce::dontSendNotification);
+        }
     }
 }
 
@@ -391,8 +395,12 @@ void PianoRollEditor::changeListenerCallback(juce::ChangeBroadcaster* source)
         {
             songDocumentEditorPtr.lock()->updateEditorContext();
 
-            const auto document_tail_seconds = songDocumentEditorPtr.lock()->getEditorContext().currentBeatTimePoints.back().absoluteTimeInSeconds;
-            pianoRollScrollBarHorizontal->setRangeLimits(juce::Range<double>{0.0, document_tail_seconds}, juce::dontSendNotification);
+            const auto& beat_time_points = songDocumentEditorPtr.lock()->getEditorContext().currentBeatTimePoints;
+            if (beat_time_points != nullptr && !beat_time_points->empty())
+            {
+                const auto document_tail_seconds = beat_time_points->back().absoluteTimeInSeconds;
+                pianoRollScrollBarHorizontal->setRangeLimits(juce::Range<double>{0.0, document_tail_seconds}, juce::dontSendNotification);
+            }
         }
     }
 }
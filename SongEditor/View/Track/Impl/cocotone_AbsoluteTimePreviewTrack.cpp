@@ -176,13 +176,21 @@ private:
         jassert(grid_size_in_seconds > 0.0);
 
         const auto absolute_time_end_in_seconds = cctn::song::SongDocument::Calculator::tickToAbsoluteTime(content, ticks_document_end);
-        for (double seconds = 0.0; seconds < absolute_time_end_in_seconds; )
+
+        std::vector<double> grid_times_in_seconds;
+        for (double seconds = 0.0; seconds < absolute_time_end_in_seconds; seconds += grid_size_in_seconds)
         {
-            const auto ticks = cctn::song::SongDocument::Calculator::absoluteTimeToTick(content, seconds);
+            grid_times_in_seconds.push_back(seconds);
+        }
 
-            currentTicksWithTime.add(TicksWithTimeInSeconds{ ticks, seconds });
+        // Convert all grid positions in one walk over the tempo map.
+        std::vector<int64_t> grid_ticks(grid_times_in_seconds.size());
+        cctn::song::SongDocument::Calculator::absoluteTimesToTicks(content, grid_times_in_seconds.data(), grid_ticks.data(), (int)grid_times_in_seconds.size());
 
-            seconds += (double)properties.getProperty("seconds", grid_size_in_seconds);
+        currentTicksWithTime.ensureStorageAllocated((int)grid_times_in_seconds.size());
+        for (size_t grid_idx = 0; grid_idx < grid_times_in_seconds.size(); grid_idx++)
+        {
+            currentTicksWithTime.add(TicksWithTimeInSeconds{ grid_ticks[grid_idx], grid_times_in_seconds[grid_idx] });
         }
     }
 
@@ -52,6 +52,13 @@ public:
         return (cctn::song::NoteLength)(int)valueGridSize.getValue();
     }
 
+    virtual juce::var getProperties()
+    {
+        juce::DynamicObject::Ptr properties = new juce::DynamicObject();
+        properties->setProperty("gridSize", (int)valueGridSize.getValue());
+        return properties;
+    };
+
 private:
     //==============================================================================
     void paint(juce::Graphics& g) override
@@ -152,7 +159,7 @@ private:
 
 //==============================================================================
 class MusicalTimePreviewTrackLane
-    : public cctn::song::TrackLaneBase<cctn::song::SongDocument::BeatTimePoints>
+    : public cctn::song::TrackLaneBase<cctn::song::SongDocument>
 {
 public:
     MusicalTimePreviewTrackLane()
@@ -175,9 +182,11 @@ private:
     }
 
     //==============================================================================
-    void updateContent(const cctn::song::SongDocument::BeatTimePoints& content, const juce::var& properties) override
+    void updateContent(const cctn::song::SongDocument& content, const juce::var& properties) override
     {
-        currentBeatTimePoints = content;
+        // Grid is generated on paint only for visible range.
+        currentTempoMap = content.getTempoMap();
+        currentGridSize = (cctn::song::NoteLength)(int)properties.getProperty("gridSize", (int)cctn::song::NoteLength::Quarter);
     }
 
     //==============================================================================
@@ -185,16 +194,22 @@ private:
     {
         juce::Graphics::ScopedSaveState save_state(g);
 
+        if (currentTempoMap.getSegments().empty())
+        {
+            return;
+        }
+
         const auto rect_area = getLocalBounds();
 
-        const auto precise_beat_and_time_array = currentBeatTimePoints;
         const auto range_visible_time_in_ticks = getViewRangeInTicks();
 
         g.setFont(juce::Font(juce::Font::getDefaultMonospacedFontName(), 10, 0));
 
         juce::String last_beat_signature = "";
-        for (const auto& beat_time_point : currentBeatTimePoints)
+        auto it = cctn::song::SongDocument::BeatTimePointsFactory::makeBeatTimePointIterator(currentTempoMap, currentGridSize, (int64_t)std::floor(range_visible_time_in_ticks.getStart()));
+        for (; (double)it->absoluteTicks <= range_visible_time_in_ticks.getEnd(); ++it)
         {
+            const auto& beat_time_point = *it;
             const auto signature_text = " " +
                 juce::String(beat_time_point.musicalTime.bar) + ":" +
                 juce::String(beat_time_point.musicalTime.beat);
@@ -217,7 +232,8 @@ private:
         }
     }
 
-    cctn::song::SongDocument::BeatTimePoints currentBeatTimePoints{};
+    cctn::song::SongDocument::TempoMap currentTempoMap{};
+    cctn::song::NoteLength currentGridSize{ cctn::song::NoteLength::Quarter };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MusicalTimePreviewTrackLane)
 };
@@ -255,24 +271,13 @@ void MusicalTimePreviewTrack::handleAsyncUpdate()
 //==============================================================================
 void MusicalTimePreviewTrack::triggerUpdateContent()
 {
-    currentBeatTimePoints.clear();
-    
     if (trackAccessDelegate.getSongDocumentEditor().has_value() && 
         trackAccessDelegate.getSongDocumentEditor().value()->getCurrentDocument().has_value())
     {
         const auto header_properties = headerComponent->getProperties();
 
-        auto grid_size = cctn::song::NoteLength::Quarter;
-        if (auto* track_header = dynamic_cast<MusicalTimePreviewTrackHeader*>(headerComponent.get()))
-        {
-            grid_size = track_header->getCurrenGridSize();
-        }
-
         const auto& song_document = *trackAccessDelegate.getSongDocumentEditor().value()->getCurrentDocument().value();
-        currentBeatTimePoints = 
-            cctn::song::SongDocument::BeatTimePointsFactory::makeBeatTimePoints(song_document, grid_size);
-
-        laneComponent->updateContent(currentBeatTimePoints, header_properties);
+        laneComponent->updateContent(song_document, header_properties);
     }
 
     repaint();
@@ -24,14 +24,11 @@ private:
     void triggerUpdateContent() override;
     void triggerUpdateVisibleRange() override;
 
-    //==============================================================================
-    cctn::song::SongDocument::BeatTimePoints currentBeatTimePoints{};
-
     //==============================================================================
     cctn::song::ITrackDataAccessDelegate& trackAccessDelegate;
 
     std::unique_ptr<cctn::song::TrackHeaderBase> headerComponent;
-    std::unique_ptr<cctn::song::TrackLaneBase<cctn::song::SongDocument::BeatTimePoints>> laneComponent;
+    std::unique_ptr<cctn::song::TrackLaneBase<cctn::song::SongDocument>> laneComponent;
 
     friend MusicalTimePreviewTrackHeader;
 
@@ -85,21 +85,19 @@ private:
         juce::int64 ticks_of_region_end = 0;
         juce::String lyrics_of_region = "";
 
-        auto current_notes = content.getNotes();
-        cctn::song::SongDocument::MusicalTmeDomainNoteComparator sorter;
-        current_notes.sort(sorter);
+        // Interval index returns notes in start order, no copy and sort needed.
+        const auto current_notes = content.findNotesInRange({ 0, std::numeric_limits<int64_t>::max() });
 
         for (const auto& note : current_notes)
         {
-            const auto ticks_note_start = cctn::song::SongDocument::Calculator::barToTick(content, note.startTimeInMusicalTime);
-
-            const auto musical_time_note_end = cctn::song::SongDocument::Calculator::calculateNoteOffPosition(content, note);
-            const auto ticks_note_end = cctn::song::SongDocument::Calculator::barToTick(content, musical_time_note_end);
+            const auto note_timing = note.getTiming();
+            const auto ticks_note_start = note_timing.noteOnTick;
+            const auto ticks_note_end = note_timing.noteOffTick;
 
             ticks_of_region_start = juce::jmin<juce::int64>(ticks_of_region_start, ticks_note_start);
             ticks_of_region_end = juce::jmax<juce::int64>(ticks_of_region_end, ticks_note_end);
 
-            lyrics_of_region += note.lyric;
+            lyrics_of_region += note.getLyric();
         }
 
         const auto new_region = Region {
@@ -0,0 +1,73 @@
+#pragma once
+
+namespace cctn
+{
+namespace song
+{
+
+//==============================================================================
+// Calls callback(indexBegin, indexEnd) for consecutive chunks of [0, numItems), each at least
+// minNumItemsPerChunk long. Chunks are taken from a shared counter by the calling thread and
+// by pool jobs alike, so the call finishes even when the pool is busy or it runs on a pool thread.
+// Returns after every taken chunk is done. A job which starts later finds no chunk left and
+// touches only the shared state, never the callback.
+template <typename ChunkCallback>
+void forEachChunkInParallel(int numItems, int minNumItemsPerChunk, juce::ThreadPool* threadPool, ChunkCallback&& callback)
+{
+    jassert(minNumItemsPerChunk > 0);
+
+    if (numItems <= 0)
+    {
+        return;
+    }
+
+    const auto num_chunks = (threadPool != nullptr)
+        ? juce::jlimit(1, threadPool->getNumThreads() + 1, numItems / minNumItemsPerChunk)
+        : 1;
+
+    if (num_chunks <= 1)
+    {
+        callback(0, numItems);
+        return;
+    }
+
+    struct SharedState
+    {
+        std::atomic<int> nextChunkIndex{ 0 };
+        std::atomic<int> numFinishedChunks{ 0 };
+        juce::WaitableEvent allChunksFinished;
+    };
+    const auto shared_state = std::make_shared<SharedState>();
+
+    // Callback is only reached through a taken chunk, and the caller waits for every taken chunk.
+    const auto process_chunks = [shared_state, &callback, numItems, num_chunks]()
+        {
+            for (;;)
+            {
+                const auto chunk_index = shared_state->nextChunkIndex.fetch_add(1);
+                if (chunk_index >= num_chunks)
+                {
+                    return;
+                }
+
+                callback((int)((int64_t)numItems * chunk_index / num_chunks), (int)((int64_t)numItems * (chunk_index + 1) / num_chunks));
+
+                if (shared_state->numFinishedChunks.fetch_add(1) + 1 == num_chunks)
+                {
+                    shared_state->allChunksFinished.signal();
+                }
+            }
+        };
+
+    for (int job_index = 1; job_index < num_chunks; ++job_index)
+    {
+        threadPool->addJob(process_chunks);
+    }
+
+    process_chunks();
+
+    shared_state->allChunksFinished.wait();
+}
+
+}
+}
@@ -24,7 +24,7 @@ enum class NoteLength
     DottedSixteenth  // Dotted sixteenth note
 };
 
-inline double getNoteValue(NoteLength noteLength)
+constexpr double getNoteValue(NoteLength noteLength)
 {
     switch (noteLength) {
     case NoteLength::Whole: return 1.0;
@@ -45,7 +45,7 @@ inline double getNoteValue(NoteLength noteLength)
     }
 }
 
-inline double getNoteLengthsPerQuarterNote(NoteLength noteLength)
+constexpr double getNoteLengthsPerQuarterNote(NoteLength noteLength)
 {
     switch (noteLength)
     {
@@ -67,6 +67,61 @@ inline double getNoteLengthsPerQuarterNote(NoteLength noteLength)
     }
 }
 
+//==============================================================================
+constexpr int kNumNoteLengths = (int)NoteLength::DottedSixteenth + 1;
+
+// Length of note in quarter notes as exact ratio. Indexed by NoteLength.
+struct NoteLengthRatio
+{
+    int numerator;
+    int denominator;
+};
+
+constexpr NoteLengthRatio kQuarterNotesPerNoteLength[kNumNoteLengths] =
+{
+    { 4, 1 },   // Whole
+    { 2, 1 },   // Half
+    { 1, 1 },   // Quarter
+    { 1, 2 },   // Eighth
+    { 1, 4 },   // Sixteenth
+    { 1, 8 },   // ThirtySecond
+    { 1, 16 },  // SixtyFourth
+    { 1, 3 },   // Triplet
+    { 1, 6 },   // EighthTriplet
+    { 1, 12 },  // SixteenthTriplet
+    { 3, 1 },   // DottedHalf
+    { 3, 2 },   // DottedQuarter
+    { 3, 4 },   // DottedEighth
+    { 3, 8 },   // DottedSixteenth
+};
+
+// Integer ticks of one note length. Never throws, usable in constant expression.
+constexpr int64_t getTicksPerNoteLength(NoteLength noteLength, int ticksPerQuarterNote)
+{
+    const auto& ratio = kQuarterNotesPerNoteLength[(int)noteLength];
+    return (int64_t)ticksPerQuarterNote * ratio.numerator / ratio.denominator;
+}
+
+//==============================================================================
+// Timing and velocity pattern over grid steps, repeated from every bar line.
+// Offsets are in grid steps, so one template works with any grid size.
+struct GrooveTemplate
+{
+    std::vector<double> stepOffsets;        // 0.0 is on grid, 0.5 is half a step late.
+    std::vector<float> stepVelocityScales;  // Same length as stepOffsets.
+
+    bool isStraight() const { return stepOffsets.empty(); }
+
+    // 0.5 is straight, 2/3 is triplet feel. Delays every second step.
+    static GrooveTemplate makeSwing(double swingRatio)
+    {
+        jassert(0.5 <= swingRatio && swingRatio < 1.0);
+        return GrooveTemplate{ { 0.0, 2.0 * swingRatio - 1.0 }, { 1.0f, 1.0f } };
+    }
+
+    JUCE_LEAK_DETECTOR(GrooveTemplate)
+};
+
 //==============================================================================
 using MoraKana = juce::String;
 using Mora = MoraKana;
@@ -100,5 +155,16 @@ struct QueryForAddPianoRollNote
     JUCE_LEAK_DETECTOR(QueryForAddPianoRollNote)
 };
 
+//==============================================================================
+struct QueryForQuantizePianoRollNotes
+{
+    std::vector<int> noteIds;       // Empty means whole song.
+    double strength{ 1.0 };         // 0.0 keeps position, 1.0 moves onto grid.
+    bool quantizeStart{ true };     // Moves note and keeps its length.
+    bool quantizeEnd{ false };      // Moves note off only.
+
+    JUCE_LEAK_DETECTOR(QueryForQuantizePianoRollNotes)
+};
+
 }
 }
@@ -30,6 +30,7 @@
 
 //==============================================================================
 #include "SongEditor/Lyric/cocotone_MoraKana.cpp"
+#include "SongEditor/Lyric/cocotone_LyricTable.cpp"
 
 #include "SongEditor/View/Track/Impl/cocotone_TimeSignatureTrack.cpp"
 #include "SongEditor/View/Track/Impl/cocotone_TempoTrack.cpp"
@@ -50,9 +51,19 @@
 
 #include "SongEditor/Quantize/cocotone_QuantizeEngine.cpp"
 
+#include "SongEditor/Document/cocotone_NoteIntervalIndex.cpp"
 #include "SongEditor/Document/cocotone_SongDocument.cpp"
+#include "SongEditor/Document/cocotone_TempoMapPublisher.cpp"
+#include "SongEditor/Document/cocotone_BeatTimePointsCache.cpp"
 #include "SongEditor/Document/cocotone_SongDocumentEditor.cpp"
 #include "SongEditor/Document/cocotone_SongDocumentTranspiler.cpp"
 
 #include "SongEditor/cocotone_SongEditorCommand.cpp"
 #include "SongEditor/cocotone_SongEditor.cpp"
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+#include "SongEditor/Document/Test/TestData.h"
+#include "SongEditor/Document/Test/cocotone_SongDocumentTests.cpp"
+#include "SongEditor/Document/Test/cocotone_SongDocumentEditorTests.cpp"
+#endif
@@ -34,12 +34,17 @@
 //==============================================================================
 
 #include "SongEditor/cocotone_SongEditorTypes.h"
+#include "SongEditor/cocotone_ParallelChunks.h"
 #include "SongEditor/cocotone_SongEditor.h"
 #include "SongEditor/cocotone_SongEditorCommand.h"
 #include "SongEditor/cocotone_IAudioThumbnailProvider.h"
 #include "SongEditor/cocotone_IPositionInfoProvider.h"
 
+#include "SongEditor/Lyric/cocotone_LyricTable.h"
+#include "SongEditor/Document/cocotone_NoteIntervalIndex.h"
 #include "SongEditor/Document/cocotone_SongDocument.h"
+#include "SongEditor/Document/cocotone_TempoMapPublisher.h"
+#include "SongEditor/Document/cocotone_BeatTimePointsCache.h"
 #include "SongEditor/Document/cocotone_SongDocumentTranspiler.h"
 #include "SongEditor/Document/cocotone_SongDocumentEditor.h"
 